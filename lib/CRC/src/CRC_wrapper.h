@@ -4,6 +4,7 @@
 #define CRC_H_
 
 #include "stdio.h"
+#include <stdint.h>
 
 uint32_t crc32(const uint8_t *ptr, uint32_t len);
 uint8_t crc8(uint8_t const msg[], uint32_t len);
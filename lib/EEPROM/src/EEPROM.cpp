@@ -23,6 +23,7 @@
 #include <Arduino.h>
 #include "EEPROM.h"
 #include <hardware/flash.h>
+#include "CRC_wrapper.h"
 
 #ifdef USE_TINYUSB
 // For Serial when selecting TinyUSB.  Can't include in the core because Arduino IDE
@@ -35,18 +36,70 @@
 
 extern "C" uint8_t _EEPROM_start;
 
+extern "C" uint8_t _EEPROM_slots_start;
+
+#define RECORD_MAGIC        0x4D4F4344  // "DCOM"
+#define SECTOR_PAGES        (EEPROM_SECTOR_SIZE / EEPROM_PAGE_SIZE)
+#define SLOT_NONE           0xFF
+
+#if !EEPROM_JOURNAL
+/* The pages of the image sector, as a _dirtyPages mask */
+static uint32_t sectorPages(int const sector) {
+  return ((1UL << SECTOR_PAGES) - 1) << (sector * SECTOR_PAGES);
+}
+#endif
+
+#if EEPROM_JOURNAL
+extern "C" uint8_t _EEPROM_journal_start;
+
+static void journalSectorErase(uint32_t offset) {
+  noInterrupts();
+  rp2040.idleOtherCore();
+  flash_range_erase((intptr_t)&_EEPROM_journal_start - (intptr_t)XIP_BASE + offset, EEPROM_JOURNAL_SECTOR_SIZE);
+  rp2040.resumeOtherCore();
+  interrupts();
+}
+
+static void journalPageProgram(uint32_t offset, const uint8_t *data) {
+  noInterrupts();
+  rp2040.idleOtherCore();
+  flash_range_program((intptr_t)&_EEPROM_journal_start - (intptr_t)XIP_BASE + offset, data, EEPROM_JOURNAL_PAGE_SIZE);
+  rp2040.resumeOtherCore();
+  interrupts();
+}
+
+EEPROMClass::EEPROMClass(void)
+  : _sector(&_EEPROM_start), _slots(&_EEPROM_slots_start), _journal(&_EEPROM_journal_start, journalSectorErase, journalPageProgram) {
+  _sector -= EEPROM_SECTOR_SIZE;
+}
+#else
 EEPROMClass::EEPROMClass(void)
-  : _sector(&_EEPROM_start) {
-  _sector -= 4096;
+  : _sector(&_EEPROM_start), _slots(&_EEPROM_slots_start) {
+  _sector -= EEPROM_SECTOR_SIZE;
 }
+#endif
 
 void EEPROMClass::begin(size_t size) {
-  if ((size <= 0) || (size > 8192)) {
-    size = 8192;
+  // Finish the update in progress, it still writes from _data
+  if (_updateState != UPDATE_IDLE) {
+    update();
+  }
+
+  if ((size <= 0) || (size > EEPROM_FLASH_SIZE)) {
+    size = EEPROM_FLASH_SIZE;
   }
 
-  _size = (size + 255) & (~255);  // Flash writes limited to 256 byte boundaries
+  _size = (size + (EEPROM_PAGE_SIZE - 1)) & (~(EEPROM_PAGE_SIZE - 1));  // Flash writes limited to 256 byte boundaries
 
+#if EEPROM_XIP_READS
+  // The reads come from flash again, a mirror created by getDataPtr() is dropped
+  if (_data) {
+    delete[] _data;
+    _data = nullptr;
+  }
+  _mirrorTemporary = false;
+  overlayClear();
+#else
   // In case begin() is called a 2nd+ time, don't reallocate if size is the same
   if (_data && size != _size) {
     delete[] _data;
@@ -54,10 +107,41 @@ void EEPROMClass::begin(size_t size) {
   } else if (!_data) {
     _data = new uint8_t[size];
   }
+#endif
 
-  memcpy(_data, _sector, _size);
+  recordActiveFind();
 
-  _dirty = false;  //make sure dirty is cleared in case begin() is called 2nd+ time
+#if EEPROM_JOURNAL
+  if (!_journal.begin(_data, _size)) {
+    // First boot with the journal, start it from the settings saved in the slots, or else in the EEPROM region
+    imageLoad();
+    _journal.compact();
+  }
+
+  _dirtyPages = 0;  //make sure dirty is cleared in case begin() is called 2nd+ time
+#else
+#if !EEPROM_XIP_READS
+  imageLoad();
+#endif
+
+  _dirtyPages = 0;  //make sure dirty is cleared in case begin() is called 2nd+ time
+  if (!_committed) {
+    // First boot with the slots, the settings come from the EEPROM region. They are saved by the next update.
+    _sequence = 0;
+    dirtyMark(0, _size);
+    needUpdate = true;
+  } else if (_committedSize != _size) {
+    // Saved with another size, as much of it as fits is kept and saved again with this size by the next update
+#if EEPROM_XIP_READS
+    // The pages past the saved size have no slot to be read from until the update saved them
+    _data = new uint8_t[_size];
+    _mirrorTemporary = true;
+    imageLoad();
+#endif
+    dirtyMark(0, _size);
+    needUpdate = true;
+  }
+#endif
 }
 
 bool EEPROMClass::end() {
@@ -68,12 +152,19 @@ bool EEPROMClass::end() {
   }
 
   retval = commit();
+  if (_updateState != UPDATE_IDLE) {
+    update();
+  }
   if (_data) {
     delete[] _data;
   }
   _data  = 0;
   _size  = 0;
-  _dirty = false;
+  _dirtyPages = 0;
+#if EEPROM_XIP_READS
+  _mirrorTemporary = false;
+  overlayClear();
+#endif
 
   return retval;
 }
@@ -82,78 +173,539 @@ uint8_t EEPROMClass::read(int const address) {
   if (address < 0 || (size_t)address >= _size) {
     return 0;
   }
-  if (!_data) {
-    return 0;
-  }
 
-  return _data[address];
+  return pageData(address / EEPROM_PAGE_SIZE)[address % EEPROM_PAGE_SIZE];
 }
 
 void EEPROMClass::write(int const address, uint8_t const value) {
   if (address < 0 || (size_t)address >= _size) {
     return;
   }
-  if (!_data) {
-    return;
-  }
 
-  // Optimise _dirty. Only flagged if data written is different.
-  uint8_t *pData = &_data[address];
-  if (*pData != value) {
-    *pData = value;
-    _dirty = true;
-  }
+  dataWrite(address, &value, 1);
 }
 
 bool EEPROMClass::commit() {
   if (!_size) {
     return false;
   }
-  if (!_dirty) {
+  if (_dirtyPages == 0) {
     return true;
   }
-  if (!_data) {
-    return false;
-  }
   needUpdate=true;
   return true;
 }
 
 uint8_t *EEPROMClass::getDataPtr() {
-  _dirty = true;
+#if EEPROM_XIP_READS
+  if (!_data) {
+    mirrorCreate();
+  }
+  _mirrorTemporary = false;
+#endif
+  // Anything may be written through the pointer
+  dirtyMark(0, _size);
   return &_data[0];
 }
 
 uint8_t const *EEPROMClass::getConstDataPtr() const {
+#if EEPROM_XIP_READS
+  if (!_data) {
+    for (int slot = 0; slot < EEPROM_OVERLAY_PAGES; ++slot) {
+      if (_overlay[slot].page >= 0) {
+        // The pending changes are not in flash, only a mirror holds the whole image
+        const_cast<EEPROMClass *>(this)->mirrorCreate();
+        return &_data[0];
+      }
+    }
+    // The image is only contiguous in flash while its sectors are in consecutive slots
+    for (int sector = 1; _committed && sector * EEPROM_SECTOR_SIZE < (int)_size; ++sector) {
+      if (_slotMap[sector] != _slotMap[0] + sector) {
+        const_cast<EEPROMClass *>(this)->mirrorCreate();
+        return &_data[0];
+      }
+    }
+    return imageSectorGet(0);
+  }
+  // The caller keeps the pointer, the mirror stays
+  const_cast<EEPROMClass *>(this)->_mirrorTemporary = false;
+#endif
   return &_data[0];
 }
 
-void EEPROMClass::erase() {
+#if EEPROM_XIP_READS
+void EEPROMClass::overlayClear() {
+  for (int slot = 0; slot < EEPROM_OVERLAY_PAGES; ++slot) {
+    _overlay[slot].page = -1;
+  }
+}
+
+/* Moves the image into a RAM mirror, the class works from it from now on */
+void EEPROMClass::mirrorCreate() {
+  uint8_t *const mirror = new uint8_t[_size];
+
+  for (int page = 0; page < (int)(_size / EEPROM_PAGE_SIZE); ++page) {
+    memcpy(&mirror[page * EEPROM_PAGE_SIZE], pageData(page), EEPROM_PAGE_SIZE);
+  }
+  _data = mirror;
+  overlayClear();
+}
+#endif
+
+/* The current content of the page, including the changes not saved yet */
+uint8_t const *EEPROMClass::pageData(int const page) const {
+#if EEPROM_XIP_READS
+  if (!_data) {
+    for (int slot = 0; slot < EEPROM_OVERLAY_PAGES; ++slot) {
+      if (_overlay[slot].page == page) {
+        return _overlay[slot].data;
+      }
+    }
+    return imageSectorGet(page / SECTOR_PAGES) + (page % SECTOR_PAGES) * EEPROM_PAGE_SIZE;
+  }
+#endif
+  return &_data[page * EEPROM_PAGE_SIZE];
+}
+
+/* The page to write the changes into. The caller marks them dirty. */
+uint8_t *EEPROMClass::pageWritable(int const page) {
+#if EEPROM_XIP_READS
+  if (!_data) {
+    int free_slot = -1;
+
+    for (int slot = 0; slot < EEPROM_OVERLAY_PAGES; ++slot) {
+      if (_overlay[slot].page == page) {
+        return _overlay[slot].data;
+      }
+      if (_overlay[slot].page < 0) {
+        free_slot = slot;
+      }
+    }
+
+    if (free_slot >= 0) {
+      memcpy(_overlay[free_slot].data, pageData(page), EEPROM_PAGE_SIZE);
+      _overlay[free_slot].page = page;
+      return _overlay[free_slot].data;
+    }
+
+    // The overlay is full. The image moves into a RAM mirror until the next update has saved it, so the write does
+    // not wait for the flash and a put() over more pages is saved as a whole.
+    mirrorCreate();
+    _mirrorTemporary = true;
+  }
+#endif
+  return &_data[page * EEPROM_PAGE_SIZE];
+}
+
+void EEPROMClass::dataRead(int const address, void *data, size_t const len) const {
+  uint8_t *dst = (uint8_t *)data;
+  int offset   = address;
+
+  while (offset < address + (int)len) {
+    int const page_offset = offset % EEPROM_PAGE_SIZE;
+    int const chunk       = (EEPROM_PAGE_SIZE - page_offset < address + (int)len - offset) ? EEPROM_PAGE_SIZE - page_offset : address + (int)len - offset;
+
+    memcpy(dst, pageData(offset / EEPROM_PAGE_SIZE) + page_offset, chunk);
+    dst += chunk;
+    offset += chunk;
+  }
+}
+
+/* Only the bytes which really change are written and flagged dirty */
+void EEPROMClass::dataWrite(int const address, void const *data, size_t const len) {
+  uint8_t const *src = (uint8_t const *)data;
+  int offset         = address;
+
+  while (offset < address + (int)len) {
+    int const page        = offset / EEPROM_PAGE_SIZE;
+    int const page_offset = offset % EEPROM_PAGE_SIZE;
+    int const chunk       = (EEPROM_PAGE_SIZE - page_offset < address + (int)len - offset) ? EEPROM_PAGE_SIZE - page_offset : address + (int)len - offset;
+
+    if (memcmp(pageData(page) + page_offset, src, chunk) != 0) {
+      memcpy(pageWritable(page) + page_offset, src, chunk);
+      dirtyMark(offset, chunk);
+    }
+    src += chunk;
+    offset += chunk;
+  }
+}
+
+void EEPROMClass::dirtyMark(int const address, size_t const len) {
+  if (address < 0 || len == 0 || (size_t)address >= _size) {
+    return;
+  }
+
+  int const first = address / EEPROM_PAGE_SIZE;
+  int const last  = (address + len - 1) / EEPROM_PAGE_SIZE;
+
+  for (int page = first; page <= last && page < (int)(_size / EEPROM_PAGE_SIZE); ++page) {
+#if EEPROM_JOURNAL
+    int const page_start = page * EEPROM_PAGE_SIZE;
+    uint8_t const low    = (page == first) ? address - page_start : 0;
+    uint8_t const high   = (page == last) ? address + len - 1 - page_start : EEPROM_PAGE_SIZE - 1;
+
+    if (!(_dirtyPages & (1UL << page))) {
+      _dirtyLow[page]  = low;
+      _dirtyHigh[page] = high;
+    } else {
+      if (low < _dirtyLow[page]) {
+        _dirtyLow[page] = low;
+      }
+      if (high > _dirtyHigh[page]) {
+        _dirtyHigh[page] = high;
+      }
+    }
+#endif
+    _dirtyPages |= (1UL << page);
+  }
+}
+
+/* True if the page holds the erased flash value only */
+bool EEPROMClass::pageBlank(int const page) const {
+  uint8_t const *data = pageData(page);
+
+  for (int i = 0; i < EEPROM_PAGE_SIZE; ++i) {
+    if (data[i] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* The committed image sector in flash, or the one of the EEPROM region before the first commit */
+uint8_t const *EEPROMClass::imageSectorGet(int const sector) const {
+  if (_committed) {
+    return slotGet(_slotMap[sector]);
+  }
+  return _sector + sector * EEPROM_SECTOR_SIZE;
+}
+
+/* Loads the committed image into _data. Past the size it was saved with, the image is erased. */
+void EEPROMClass::imageLoad() {
+  size_t const image_size = _committed ? _committedSize : EEPROM_FLASH_SIZE;
+
+  for (size_t offset = 0; offset < _size; offset += EEPROM_SECTOR_SIZE) {
+    size_t const len = (_size - offset < EEPROM_SECTOR_SIZE) ? _size - offset : EEPROM_SECTOR_SIZE;
+    size_t loaded    = 0;
+
+    if (offset < image_size) {
+      loaded = (image_size - offset < len) ? image_size - offset : len;
+      memcpy(&_data[offset], imageSectorGet(offset / EEPROM_SECTOR_SIZE), loaded);
+    }
+    memset(&_data[offset + loaded], 0xFF, len - loaded);
+  }
+}
+
+/* True if the record is intact */
+bool EEPROMClass::recordRead(int const record, CommitRecord &commit_record) const {
+  memcpy(&commit_record, recordGet(record), sizeof(commit_record));
+  if (commit_record.magic != RECORD_MAGIC || commit_record.size == 0 || commit_record.size > EEPROM_FLASH_SIZE) {
+    return false;
+  }
+  return commit_record.record_crc == crc32((uint8_t const *)&commit_record, offsetof(CommitRecord, record_crc));
+}
+
+/* True if every image sector of the record matches its CRC. The record may have been saved with another size. */
+bool EEPROMClass::recordSectorsValid(CommitRecord const &commit_record) const {
+  for (size_t offset = 0; offset < commit_record.size; offset += EEPROM_SECTOR_SIZE) {
+    int const sector = offset / EEPROM_SECTOR_SIZE;
+    size_t const len = (commit_record.size - offset < EEPROM_SECTOR_SIZE) ? commit_record.size - offset : EEPROM_SECTOR_SIZE;
+
+    if (commit_record.slots[sector] >= EEPROM_SLOTS_COUNT ||
+        commit_record.sector_crc[sector] != crc32(slotGet(commit_record.slots[sector]), len)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* The newest record whose sectors are intact is the active one, the next record is appended after it */
+void EEPROMClass::recordActiveFind() {
+  CommitRecord commit_record;
+  CommitRecord newest;
+  int active     = -1;
+  bool bounded   = false;
+  uint32_t below = 0;
+
+  _committed = false;
+  memset(_slotMap, SLOT_NONE, sizeof(_slotMap));
+
+  // Only the sectors of the newest intact record are checked, an older one is tried if they are not
+  while (active < 0) {
+    int candidate = -1;
+
+    for (int record = 0; record < EEPROM_RECORDS_COUNT; ++record) {
+      if (recordRead(record, commit_record) && (!bounded || (int32_t)(commit_record.sequence - below) < 0) &&
+          (candidate < 0 || (int32_t)(commit_record.sequence - newest.sequence) > 0)) {
+        candidate = record;
+        newest    = commit_record;
+      }
+    }
+    if (candidate < 0) {
+      break;
+    }
+    if (!bounded) {
+      // The next record is newer than every intact one, even one whose sectors are not
+      _sequence = newest.sequence;
+    }
+    if (recordSectorsValid(newest)) {
+      active = candidate;
+    }
+    bounded = true;
+    below   = newest.sequence;
+  }
+
+  if (active >= 0) {
+    _committed     = true;
+    _committedSize = newest.size;
+    memcpy(_slotMap, newest.slots, sizeof(_slotMap));
+  }
+
+  _recordNext = 0;
+  if (!_committed) {
+    return;
+  }
+
+  // Past any record torn by a reset, nothing is programmed over it
+  _recordNext = active + 1;
+  for (int record = active + 1; record % EEPROM_RECORDS_PER_SECTOR != 0; ++record) {
+    uint8_t const *data = recordGet(record);
+
+    for (int i = 0; i < EEPROM_RECORD_SIZE; ++i) {
+      if (data[i] != 0xFF) {
+        _recordNext = record + 1;
+        break;
+      }
+    }
+  }
+  _recordNext %= EEPROM_RECORDS_COUNT;
+  _slotNext = _sequence % EEPROM_SLOTS_COUNT;
+}
+
+/* The next slot not holding an image sector, neither the committed one nor the one of the current update */
+uint8_t EEPROMClass::slotFree() {
+  for (int i = 0; i < EEPROM_SLOTS_COUNT; ++i) {
+    uint8_t const slot = (_slotNext + i) % EEPROM_SLOTS_COUNT;
+    bool used          = false;
+
+    for (int sector = 0; sector < EEPROM_IMAGE_SECTORS; ++sector) {
+      if (_slotMap[sector] == slot || ((_updateSectors & (1 << sector)) && _updateSlots[sector] == slot)) {
+        used = true;
+      }
+    }
+    if (!used) {
+      _slotNext = (slot + 1) % EEPROM_SLOTS_COUNT;
+      return slot;
+    }
+  }
+  return SLOT_NONE;  // Unreachable, every image sector has a spare slot
+}
+
+void EEPROMClass::sectorErase(uint8_t *sector) {
   noInterrupts();
   rp2040.idleOtherCore();
-  flash_range_erase((intptr_t)_sector - (intptr_t)XIP_BASE, 8192 / 2);
+  flash_range_erase((intptr_t)sector - (intptr_t)XIP_BASE, EEPROM_SECTOR_SIZE);
   rp2040.resumeOtherCore();
   interrupts();
+}
+
+void EEPROMClass::pageProgram(uint8_t *page, uint8_t const *data) {
   noInterrupts();
   rp2040.idleOtherCore();
-  flash_range_erase((intptr_t)_sector - (intptr_t)XIP_BASE + (8192 / 2), 8192 / 2);
+  flash_range_program((intptr_t)page - (intptr_t)XIP_BASE, data, EEPROM_PAGE_SIZE);
   rp2040.resumeOtherCore();
   interrupts();
 }
 
+void EEPROMClass::erase() {
+  // The storage is erased, the image is kept as it is, like the RAM copy always was. The next update saves it whole.
+  _updateState = UPDATE_IDLE;
+#if EEPROM_XIP_READS
+  if (_size && !_data) {
+    mirrorCreate();
+  }
+  _mirrorTemporary = false;
+#endif
+#if EEPROM_JOURNAL
+  _journal.erase();
+#endif
+  // The slots, the records, and the EEPROM region they would import the settings from otherwise
+  for (int sector = 0; sector < EEPROM_SLOTS_COUNT + EEPROM_RECORD_SECTORS; ++sector) {
+    sectorErase(slotGet(sector));
+  }
+  for (int sector = 0; sector < EEPROM_FLASH_SIZE / EEPROM_SECTOR_SIZE; ++sector) {
+    sectorErase(_sector + sector * EEPROM_SECTOR_SIZE);
+  }
+  _committed  = false;
+  _recordNext = 0;
+  memset(_slotMap, SLOT_NONE, sizeof(_slotMap));
+}
+
 void EEPROMClass::update() {
-  //Shutdown keyboard side
-  erase();
-  for (int i = 0; i < 8192 / 256; ++i) {
-    noInterrupts();
-    rp2040.idleOtherCore();
-    flash_range_program((intptr_t)_sector - (intptr_t)XIP_BASE + i * 256, &_data[i * 256], 256);
-    rp2040.resumeOtherCore();
-    interrupts();
+  while (updateStep()) {
+  }
+}
+
+#if EEPROM_JOURNAL
+bool EEPROMClass::updateStep() {
+  int const pages_count = _size / EEPROM_PAGE_SIZE;
+
+  if (_updateState == UPDATE_IDLE) {
+    // A commit made while the update runs asks for the next one
+    needUpdate   = false;
+    _updateIndex = 0;
+    _updateState = UPDATE_PROGRAM;
   }
-  needUpdate = false;
+
+  // One dirty page per step, only its changed bytes are appended
+  for (; _updateIndex < pages_count; ++_updateIndex) {
+    uint32_t const page_mask = 1UL << _updateIndex;
+
+    if (!(_dirtyPages & page_mask)) {
+      continue;
+    }
+    if (!_journal.append(_updateIndex * EEPROM_PAGE_SIZE + _dirtyLow[_updateIndex], _dirtyHigh[_updateIndex] - _dirtyLow[_updateIndex] + 1)) {
+      // The journal is being compacted, the step wrote a part of the snapshot. The page follows it.
+      return true;
+    }
+    _dirtyPages &= ~page_mask;
+    ++_updateIndex;
+    return true;
+  }
+
+  _journal.flush();
+  _updateState = UPDATE_IDLE;
+  return false;
 }
 
+bool EEPROMClass::maintenance() {
+  return _journal.maintenance();
+}
+#else
+bool EEPROMClass::updateStep() {
+  int const pages_count   = _size / EEPROM_PAGE_SIZE;
+  int const sectors_count = (_size + EEPROM_SECTOR_SIZE - 1) / EEPROM_SECTOR_SIZE;
+  CommitRecord commit_record;
+  uint8_t page[EEPROM_PAGE_SIZE];
+
+  switch (_updateState) {
+  case UPDATE_IDLE:
+    // A change made while the update runs asks for the next one
+    needUpdate     = false;
+    _updateSectors = 0;
+    for (int sector = 0; sector < sectors_count; ++sector) {
+      if (!_committed || (_dirtyPages & sectorPages(sector))) {
+        _updateSlots[sector] = slotFree();
+        _updateSectors |= 1 << sector;
+      }
+    }
+    _dirtyPages = 0;
+    if (_updateSectors == 0) {
+      return false;
+    }
+    _updateIndex = 0;
+    _updateState = UPDATE_ERASE;
+    // fall through
+
+  case UPDATE_ERASE:
+    // The slots of the changed sectors, then the record sector if the record is its first one
+    for (; _updateIndex < sectors_count; ++_updateIndex) {
+      if (_updateSectors & (1 << _updateIndex)) {
+        sectorErase(slotGet(_updateSlots[_updateIndex]));
+        ++_updateIndex;
+        return true;
+      }
+    }
+    if (_updateIndex == sectors_count && _recordNext % EEPROM_RECORDS_PER_SECTOR == 0) {
+      sectorErase(recordGet(_recordNext));
+      ++_updateIndex;
+      return true;
+    }
+    _updateIndex = 0;
+    _updateState = UPDATE_PROGRAM;
+    // fall through
+
+  case UPDATE_PROGRAM:
+    // The blank pages stay erased
+    for (; _updateIndex < pages_count; ++_updateIndex) {
+      int const sector = _updateIndex / SECTOR_PAGES;
+
+      if ((_updateSectors & (1 << sector)) && !pageBlank(_updateIndex)) {
+        // The page may be in flash, which can't be read while programming
+        memcpy(page, pageData(_updateIndex), EEPROM_PAGE_SIZE);
+        pageProgram(slotGet(_updateSlots[sector]) + (_updateIndex % SECTOR_PAGES) * EEPROM_PAGE_SIZE, page);
+        ++_updateIndex;
+        return true;
+      }
+    }
+    _updateState = UPDATE_COMMIT;
+    // fall through
+
+  case UPDATE_COMMIT:
+    _updateState = UPDATE_IDLE;
+
+    memset(&commit_record, 0xFF, sizeof(commit_record));
+    for (int sector = 0; sector < sectors_count; ++sector) {
+      commit_record.slots[sector] = (_updateSectors & (1 << sector)) ? _updateSlots[sector] : _slotMap[sector];
+    }
+
+    // The image may have changed while it was being written, it is only committed if the slots hold it as it is now
+    for (int i = 0; i < pages_count; ++i) {
+      uint8_t const *slot_page = slotGet(commit_record.slots[i / SECTOR_PAGES]) + (i % SECTOR_PAGES) * EEPROM_PAGE_SIZE;
+
+      if (memcmp(slot_page, pageData(i), EEPROM_PAGE_SIZE) != 0) {
+        // The rewritten sectors are not committed, the next update writes them again
+        for (int sector = 0; sector < sectors_count; ++sector) {
+          if (_updateSectors & (1 << sector)) {
+            _dirtyPages |= sectorPages(sector);
+          }
+        }
+        needUpdate = true;
+        return false;
+      }
+    }
+
+    commit_record.magic    = RECORD_MAGIC;
+    commit_record.sequence = _sequence + 1;
+    commit_record.size     = _size;
+    for (size_t offset = 0; offset < _size; offset += EEPROM_SECTOR_SIZE) {
+      int const sector = offset / EEPROM_SECTOR_SIZE;
+      size_t const len = (_size - offset < EEPROM_SECTOR_SIZE) ? _size - offset : EEPROM_SECTOR_SIZE;
+
+      commit_record.sector_crc[sector] = crc32(slotGet(commit_record.slots[sector]), len);
+    }
+    commit_record.record_crc = crc32((uint8_t const *)&commit_record, offsetof(CommitRecord, record_crc));
+
+    // The rest of the page stays 0xFF, programming it over the records already there leaves them untouched
+    memset(page, 0xFF, sizeof(page));
+    memcpy(&page[(_recordNext * EEPROM_RECORD_SIZE) % EEPROM_PAGE_SIZE], &commit_record, sizeof(commit_record));
+    pageProgram(recordGet(_recordNext - _recordNext % (EEPROM_PAGE_SIZE / EEPROM_RECORD_SIZE)), page);
+
+    _committed     = true;
+    _committedSize = _size;
+    _sequence      = commit_record.sequence;
+    _recordNext = (_recordNext + 1) % EEPROM_RECORDS_COUNT;
+    memcpy(_slotMap, commit_record.slots, sizeof(_slotMap));
+#if EEPROM_XIP_READS
+    // The slots hold every change of the overlay, or of the mirror a write moved the image into
+    if (!_data) {
+      overlayClear();
+    } else if (_mirrorTemporary && _dirtyPages == 0) {
+      delete[] _data;
+      _data            = nullptr;
+      _mirrorTemporary = false;
+    }
+#endif
+    return false;
+  }
+  return false;
+}
+
+bool EEPROMClass::maintenance() {
+  return false;
+}
+#endif
+
 bool EEPROMClass::getNeedUpdate() {
   return needUpdate;
 }
@@ -25,6 +25,52 @@
 #include <stdint.h>
 #include <string.h>
 
+#define EEPROM_FLASH_SIZE   8192    // Flash reserved for the emulation, two erase sectors
+#define EEPROM_SECTOR_SIZE  4096    // Flash erase granularity
+#define EEPROM_PAGE_SIZE    256     // Flash program granularity, the dirty tracking unit
+
+/*
+ * Without the journal the image is kept in sector slots below the EEPROM region, every image sector has a spare one. An
+ * update only rewrites the image sectors that changed, each into a free slot, verifies them and then appends a commit
+ * record, which maps every image sector to its slot. A reset at any point leaves the previous image intact. The record
+ * holds a sequence number and the CRC32 of every image sector, at boot the valid record with the newest sequence is
+ * loaded. The records are appended to two sectors in turn, one of them is erased every EEPROM_RECORDS_PER_SECTOR commits.
+ */
+#define EEPROM_IMAGE_SECTORS        (EEPROM_FLASH_SIZE / EEPROM_SECTOR_SIZE)
+#define EEPROM_SLOTS_COUNT          (2 * EEPROM_IMAGE_SECTORS)
+#define EEPROM_RECORD_SECTORS       2
+#define EEPROM_RECORD_SIZE          32
+#define EEPROM_RECORDS_PER_SECTOR   (EEPROM_SECTOR_SIZE / EEPROM_RECORD_SIZE)
+#define EEPROM_RECORDS_COUNT        (EEPROM_RECORD_SECTORS * EEPROM_RECORDS_PER_SECTOR)
+
+/*
+ * With EEPROM_JOURNAL the commits are appended to a journal rotating over EEPROM_JOURNAL_SECTORS flash sectors below the
+ * slots, instead of rewriting whole sectors. The slots are then only read once, to import the settings saved by a
+ * firmware without the journal.
+ */
+#ifndef EEPROM_JOURNAL
+#define EEPROM_JOURNAL      0
+#endif
+
+#if EEPROM_JOURNAL
+#include "EEPROMJournal.h"
+#endif
+
+/*
+ * With EEPROM_XIP_READS the image is not mirrored in RAM. The reads are served from the active slots through the XIP
+ * flash mapping, the writes go to EEPROM_OVERLAY_PAGES page buffers until the next update saves them into free slots.
+ * A write needing one more page buffer moves the image into a RAM mirror, which the update drops once it has saved it.
+ * getDataPtr() needs the whole image in RAM, its first call allocates the mirror and the class keeps working from it.
+ */
+#ifndef EEPROM_XIP_READS
+#define EEPROM_XIP_READS    0
+#endif
+#define EEPROM_OVERLAY_PAGES    4
+
+#if EEPROM_XIP_READS && EEPROM_JOURNAL
+#error "EEPROM_XIP_READS reads the image from the sector slots, the journal does not keep them"
+#endif
+
 class EEPROMClass {
  public:
   EEPROMClass(void);
@@ -44,7 +90,7 @@ class EEPROMClass {
       return t;
     }
 
-    memcpy((uint8_t *)&t, _data + address, sizeof(T));
+    dataRead(address, &t, sizeof(T));
     return t;
   }
 
@@ -53,11 +99,7 @@ class EEPROMClass {
     if (address < 0 || address + sizeof(T) > _size) {
       return t;
     }
-    if (memcmp(_data + address, (const uint8_t *)&t, sizeof(T)) != 0) {
-      _dirty = true;
-      memcpy(_data + address, (const uint8_t *)&t, sizeof(T));
-    }
-
+    dataWrite(address, &t, sizeof(T));
     return t;
   }
 
@@ -69,24 +111,140 @@ class EEPROMClass {
     return _size;
   }
 
-  uint8_t &operator[](int const address) {
-    return getDataPtr()[address];
+  /*
+   * Reference to a byte of the image, as returned by operator[]. Reading through it leaves the page clean, and with
+   * EEPROM_XIP_READS takes no page buffer, only an assignment writes the byte.
+   */
+  class Ref {
+   public:
+    Ref(EEPROMClass &eeprom, int const address) : _eeprom(eeprom), _address(address) {}
+
+    operator uint8_t() const {
+      return _eeprom.read(_address);
+    }
+    Ref &operator=(uint8_t const value) {
+      _eeprom.write(_address, value);
+      return *this;
+    }
+    Ref &operator=(Ref const &ref) {
+      return *this = static_cast<uint8_t>(ref);
+    }
+    Ref &operator+=(uint8_t const value) {
+      return *this = static_cast<uint8_t>(*this + value);
+    }
+    Ref &operator-=(uint8_t const value) {
+      return *this = static_cast<uint8_t>(*this - value);
+    }
+    Ref &operator&=(uint8_t const value) {
+      return *this = static_cast<uint8_t>(*this & value);
+    }
+    Ref &operator|=(uint8_t const value) {
+      return *this = static_cast<uint8_t>(*this | value);
+    }
+    Ref &operator^=(uint8_t const value) {
+      return *this = static_cast<uint8_t>(*this ^ value);
+    }
+
+   private:
+    EEPROMClass &_eeprom;
+    int const _address;
+  };
+
+  Ref operator[](int const address) {
+    return Ref(*this, address);
   }
   uint8_t const &operator[](int const address) const {
-    return getConstDataPtr()[address];
+    return pageData(address / EEPROM_PAGE_SIZE)[address % EEPROM_PAGE_SIZE];
   }
 
   void erase();
 
   bool getNeedUpdate();
   void update();
+  bool updateStep();   // Does the next flash operation of the update, false once it is complete
+  bool maintenance();  // One step of the background flash work, false if there was nothing to do
 
  protected:
   bool needUpdate = false;
   uint8_t *_sector;
   uint8_t *_data = nullptr;
   size_t _size   = 0;
-  bool _dirty    = false;
+  uint32_t _dirtyPages = 0;   // One bit per EEPROM_PAGE_SIZE page changed since the last update()
+
+  // The update runs one flash operation per updateStep(), so the keys are scanned and reported in between
+  enum UpdateState : uint8_t {
+    UPDATE_IDLE,
+    UPDATE_ERASE,       // Erasing the slots of the changed image sectors, and the record sector to append to
+    UPDATE_PROGRAM,     // Programming the changed image sectors into their slots, or appending the dirty pages to the journal
+    UPDATE_COMMIT,      // Verifying the slots and appending the commit record
+  };
+  UpdateState _updateState = UPDATE_IDLE;
+  int _updateIndex         = 0;   // Next sector or page of the current update state
+  uint8_t _updateSectors   = 0;   // One bit per image sector rewritten by the current update
+  uint8_t _updateSlots[EEPROM_IMAGE_SECTORS];
+
+  struct CommitRecord {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t size;
+    uint8_t slots[EEPROM_IMAGE_SECTORS];  // Slot of every image sector
+    uint16_t reserved;
+    uint32_t sector_crc[EEPROM_IMAGE_SECTORS];
+    uint32_t record_crc;
+  };
+  static_assert(sizeof(CommitRecord) <= EEPROM_RECORD_SIZE, "The commit record does not fit into its place");
+
+  uint8_t *_slots;
+  bool _committed       = false;  // The image is in the slots, else it is still the one of the EEPROM region
+  size_t _committedSize = 0;      // Size the committed image was saved with, begin() may be called with another one
+  uint8_t _slotMap[EEPROM_IMAGE_SECTORS];
+  uint8_t _slotNext     = 0;      // The free slots are taken in turn, so their erases rotate
+  uint32_t _sequence    = 0;
+  int _recordNext       = 0;      // Index of the next record, a record sector is erased before its first one
+
+  uint8_t *slotGet(int const slot) const {
+    return _slots + slot * EEPROM_SECTOR_SIZE;
+  }
+  uint8_t *recordGet(int const record) const {
+    return _slots + EEPROM_SLOTS_COUNT * EEPROM_SECTOR_SIZE + record * EEPROM_RECORD_SIZE;
+  }
+  uint8_t const *imageSectorGet(int const sector) const;
+  void imageLoad();
+  bool recordRead(int const record, CommitRecord &commit_record) const;
+  bool recordSectorsValid(CommitRecord const &commit_record) const;
+  void recordActiveFind();
+  uint8_t slotFree();
+  void sectorErase(uint8_t *sector);
+  void pageProgram(uint8_t *page, uint8_t const *data);
+
+#if EEPROM_JOURNAL
+  EEPROMJournal _journal;
+  uint8_t _dirtyLow[EEPROM_FLASH_SIZE / EEPROM_PAGE_SIZE];   // Changed bytes of every dirty page, as offsets in the page
+  uint8_t _dirtyHigh[EEPROM_FLASH_SIZE / EEPROM_PAGE_SIZE];
+#endif
+
+#if EEPROM_XIP_READS
+  struct OverlayPage {
+    int16_t page;       // -1 while unused
+    uint8_t data[EEPROM_PAGE_SIZE];
+  };
+
+  OverlayPage _overlay[EEPROM_OVERLAY_PAGES];
+  bool _mirrorTemporary = false;  // The mirror only holds the changes the overlay had no room for
+
+  void overlayClear();
+  void mirrorCreate();
+#endif
+
+  uint8_t const *pageData(int const page) const;
+  uint8_t *pageWritable(int const page);
+  void dataRead(int const address, void *data, size_t const len) const;
+  void dataWrite(int const address, void const *data, size_t const len);
+  void dirtyMark(int const address, size_t const len);
+  bool pageBlank(int const page) const;
 };
 
+static_assert(EEPROM_FLASH_SIZE / EEPROM_PAGE_SIZE <= 32, "The dirty pages do not fit into the _dirtyPages bitmap");
+static_assert(EEPROM_IMAGE_SECTORS <= 8, "The image sectors do not fit into the _updateSectors bitmap");
+
 extern EEPROMClass EEPROM;
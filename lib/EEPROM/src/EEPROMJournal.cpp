@@ -0,0 +1,415 @@
+/*
+    EEPROMJournal.cpp - Log-structured flash backend of the RP2040 EEPROM emulation
+    Copyright (c) 2024 Dygma Lab S.L.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include "CRC_wrapper.h"
+#include "EEPROMJournal.h"
+
+#define JOURNAL_MAGIC         0x4A4C5944  // "DYLJ"
+#define RECORD_ADDRESS_BLANK  0xFFFF
+#define RECORD_ADDRESS_END    0xFFFE      // Closes the snapshot of a generation
+#define PAGE_OFFSET_NONE      0xFFFFFFFF
+#define SECTOR_NONE           0xFF
+
+static_assert(EEPROM_JOURNAL_SECTORS < SECTOR_NONE, "The sector numbers do not fit into uint8_t");
+static_assert(EEPROM_JOURNAL_SECTOR_SIZE % EEPROM_JOURNAL_PAGE_SIZE == 0, "The sector must hold whole pages");
+
+static inline uint32_t recordStride(uint16_t length) {
+  // The records stay word aligned
+  return 8 + ((length + 3) & ~3);
+}
+
+EEPROMJournal::EEPROMJournal(const uint8_t *flash, SectorEraseFn sector_erase, PageProgramFn page_program)
+  : _flash(flash), _sector_erase(sector_erase), _page_program(page_program), _pageOffset(PAGE_OFFSET_NONE) {
+  static_assert(sizeof(RecordHeader) == 8, "recordStride() expects an 8 byte record header");
+  static_assert(SNAPSHOT_SECTORS < EEPROM_JOURNAL_SECTORS / 2, "The journal is too small to compact into");
+}
+
+uint32_t EEPROMJournal::recordCrc(uint16_t address, uint16_t length, const uint8_t *data) {
+  return crc32(data, length) ^ (((uint32_t)length << 16) | address);
+}
+
+bool EEPROMJournal::sectorHeaderRead(uint8_t sector, SectorHeader &header) const {
+  memcpy(&header, &_flash[sector * EEPROM_JOURNAL_SECTOR_SIZE], sizeof(header));
+  if (header.magic != JOURNAL_MAGIC) {
+    return false;
+  }
+  return header.crc == crc32((const uint8_t *)&header, offsetof(SectorHeader, crc));
+}
+
+bool EEPROMJournal::sectorBlank(uint8_t sector) const {
+  const uint32_t *words = (const uint32_t *)&_flash[sector * EEPROM_JOURNAL_SECTOR_SIZE];
+
+  for (uint32_t i = 0; i < EEPROM_JOURNAL_SECTOR_SIZE / sizeof(uint32_t); ++i) {
+    if (words[i] != 0xFFFFFFFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Walks the valid records of the sector, copying them into the image if apply is set. Returns false if the space after
+ * the last valid record is not erased anymore, a record was torn there. */
+bool EEPROMJournal::sectorReplay(uint8_t sector, bool apply, bool &snapshot_complete, uint32_t &end_offset) {
+  uint32_t offset     = sector * EEPROM_JOURNAL_SECTOR_SIZE + sizeof(SectorHeader);
+  uint32_t const end  = (sector + 1) * EEPROM_JOURNAL_SECTOR_SIZE;
+  RecordHeader record;
+
+  while (offset + sizeof(record) <= end) {
+    memcpy(&record, &_flash[offset], sizeof(record));
+    const uint8_t *data = &_flash[offset + sizeof(record)];
+
+    if (record.address == RECORD_ADDRESS_BLANK) {
+      break;
+    }
+    if (record.length > EEPROM_JOURNAL_RECORD_DATA_MAX || offset + recordStride(record.length) > end) {
+      break;
+    }
+    if (record.crc != recordCrc(record.address, record.length, data)) {
+      break;
+    }
+
+    if (record.address == RECORD_ADDRESS_END) {
+      snapshot_complete = true;
+    } else if (apply && (size_t)record.address + record.length <= _size) {
+      memcpy(&_image[record.address], data, record.length);
+    }
+    offset += recordStride(record.length);
+  }
+
+  end_offset = offset;
+  for (; offset < end; ++offset) {
+    if (_flash[offset] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool EEPROMJournal::begin(uint8_t *image, size_t size) {
+  SectorHeader header;
+  uint32_t upper = 0xFFFFFFFF;
+  bool snapshot_complete = false;
+
+  _image         = image;
+  _size          = size;
+  _generation    = 0;
+  _generationMax = 0;
+  _chainLength   = 0;
+  _compacting    = false;
+  _pageOffset    = PAGE_OFFSET_NONE;
+  _pageDirty     = false;
+
+  for (uint8_t sector = 0; sector < EEPROM_JOURNAL_SECTORS; ++sector) {
+    if (sectorHeaderRead(sector, header) && header.generation > _generationMax) {
+      _generationMax = header.generation;
+    }
+  }
+
+  // Look for the newest generation whose snapshot was completed, a compaction may have been interrupted
+  while (!snapshot_complete) {
+    uint32_t generation = 0;
+    uint32_t end_offset;
+
+    for (uint8_t sector = 0; sector < EEPROM_JOURNAL_SECTORS; ++sector) {
+      if (sectorHeaderRead(sector, header) && header.generation < upper && header.generation > generation) {
+        generation = header.generation;
+      }
+    }
+    if (generation == 0) {
+      break;
+    }
+    upper = generation;
+
+    // Chain the sectors of the generation in their index order
+    _chainLength = 0;
+    for (uint16_t index = 0; index < EEPROM_JOURNAL_SECTORS; ++index) {
+      uint8_t found = SECTOR_NONE;
+      for (uint8_t sector = 0; sector < EEPROM_JOURNAL_SECTORS; ++sector) {
+        if (sectorHeaderRead(sector, header) && header.generation == generation && header.index == index) {
+          found = sector;
+          break;
+        }
+      }
+      if (found == SECTOR_NONE) {
+        break;
+      }
+      _chain[_chainLength++] = found;
+    }
+
+    for (uint8_t i = 0; i < _chainLength && !snapshot_complete; ++i) {
+      sectorReplay(_chain[i], false, snapshot_complete, end_offset);
+    }
+    if (snapshot_complete) {
+      _generation = generation;
+    }
+  }
+
+  if (!snapshot_complete) {
+    _chainLength = 0;
+  }
+
+  for (uint8_t sector = 0; sector < EEPROM_JOURNAL_SECTORS; ++sector) {
+    _state[sector] = sectorBlank(sector) ? SECTOR_ERASED : SECTOR_OBSOLETE;
+  }
+
+  for (uint8_t i = 0; i < _chainLength; ++i) {
+    uint8_t const sector = _chain[i];
+    uint32_t end_offset;
+    bool tail_erased = sectorReplay(sector, true, snapshot_complete, end_offset);
+
+    _state[sector] = SECTOR_CHAIN;
+    _lastSector    = sector;
+    // The records go on after the last valid one, unless a torn record left the rest of the sector unusable
+    _writeOffset   = tail_erased ? end_offset : (sector + 1) * EEPROM_JOURNAL_SECTOR_SIZE;
+  }
+
+  return _chainLength != 0;
+}
+
+uint8_t EEPROMJournal::sectorsFree() const {
+  uint8_t count = 0;
+
+  for (uint8_t sector = 0; sector < EEPROM_JOURNAL_SECTORS; ++sector) {
+    if (_state[sector] == SECTOR_ERASED || _state[sector] == SECTOR_OBSOLETE) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/* Takes the next free sector after the current one, so the erases rotate over the whole journal */
+uint8_t EEPROMJournal::sectorTake() {
+  uint8_t const start = (_chainLength != 0) ? (_chain[_chainLength - 1] + 1) : _lastSector + 1;
+
+  for (uint8_t i = 0; i < EEPROM_JOURNAL_SECTORS; ++i) {
+    uint8_t const sector = (start + i) % EEPROM_JOURNAL_SECTORS;
+    if (_state[sector] == SECTOR_ERASED) {
+      return sector;
+    }
+  }
+
+  // No sector was erased in the background yet, erase one now
+  for (uint8_t i = 0; i < EEPROM_JOURNAL_SECTORS; ++i) {
+    uint8_t const sector = (start + i) % EEPROM_JOURNAL_SECTORS;
+    if (_state[sector] == SECTOR_OBSOLETE) {
+      _sector_erase(sector * EEPROM_JOURNAL_SECTOR_SIZE);
+      _state[sector] = SECTOR_ERASED;
+      _operations++;
+      return sector;
+    }
+  }
+  return SECTOR_NONE;
+}
+
+/* Moves the writing on to a new sector. Returns false if a compaction was started instead, it also starts the first
+ * generation after an erase(). */
+bool EEPROMJournal::sectorOpen() {
+  SectorHeader header;
+  uint8_t sector;
+
+  if (!_compacting && (_chainLength == 0 || sectorsFree() <= SNAPSHOT_SECTORS)) {
+    compactStart();
+    return false;
+  }
+
+  flush();
+  sector = sectorTake();
+  if (sector == SECTOR_NONE) {
+    return false;
+  }
+
+  header.magic      = JOURNAL_MAGIC;
+  header.generation = _generation;
+  header.index      = _chainLength;
+  header.reserved   = 0xFFFF;
+  header.crc        = crc32((const uint8_t *)&header, offsetof(SectorHeader, crc));
+  write(sector * EEPROM_JOURNAL_SECTOR_SIZE, &header, sizeof(header));
+
+  _state[sector]             = SECTOR_CHAIN;
+  _chain[_chainLength++]     = sector;
+  _lastSector                = sector;
+  _writeOffset               = sector * EEPROM_JOURNAL_SECTOR_SIZE + sizeof(header);
+  return true;
+}
+
+/* Buffers the bytes into the flash page they belong to. The rest of the page stays 0xFF, programming it over the
+ * records already there leaves them untouched. */
+void EEPROMJournal::write(uint32_t offset, const void *data, size_t len) {
+  const uint8_t *src = (const uint8_t *)data;
+
+  while (len != 0) {
+    uint32_t const page_offset = offset & ~(EEPROM_JOURNAL_PAGE_SIZE - 1);
+    size_t in_page             = EEPROM_JOURNAL_PAGE_SIZE - (offset - page_offset);
+
+    if (page_offset != _pageOffset) {
+      flush();
+      memset(_page, 0xFF, sizeof(_page));
+      _pageOffset = page_offset;
+    }
+    if (in_page > len) {
+      in_page = len;
+    }
+
+    memcpy(&_page[offset - page_offset], src, in_page);
+    _pageDirty = true;
+
+    offset += in_page;
+    src += in_page;
+    len -= in_page;
+  }
+}
+
+void EEPROMJournal::flush() {
+  if (_pageDirty) {
+    _page_program(_pageOffset, _page);
+    _pageDirty = false;
+    _operations++;
+  }
+  _pageOffset = PAGE_OFFSET_NONE;
+}
+
+bool EEPROMJournal::recordWrite(uint16_t address, const uint8_t *data, uint16_t length) {
+  RecordHeader record;
+  uint32_t const stride = recordStride(length);
+
+  if (_chainLength == 0 || _writeOffset + stride > (uint32_t)(_chain[_chainLength - 1] + 1) * EEPROM_JOURNAL_SECTOR_SIZE) {
+    if (!sectorOpen()) {
+      return false;
+    }
+  }
+
+  record.address = address;
+  record.length  = length;
+  record.crc     = recordCrc(address, length, data);
+  write(_writeOffset, &record, sizeof(record));
+  write(_writeOffset + sizeof(record), data, length);
+
+  _writeOffset += stride;
+  return true;
+}
+
+bool EEPROMJournal::append(uint16_t address, uint16_t length) {
+  // The records join the new generation after its snapshot
+  if (_compacting) {
+    compactStep();
+    return false;
+  }
+
+  while (length != 0) {
+    uint16_t const chunk = (length > EEPROM_JOURNAL_RECORD_DATA_MAX) ? EEPROM_JOURNAL_RECORD_DATA_MAX : length;
+
+    if (!recordWrite(address, &_image[address], chunk)) {
+      return false;
+    }
+    address += chunk;
+    length -= chunk;
+  }
+  return true;
+}
+
+void EEPROMJournal::compact() {
+  if (!_compacting) {
+    compactStart();
+  }
+  while (_compacting) {
+    compactStep();
+  }
+}
+
+void EEPROMJournal::compactStart() {
+  flush();
+
+  // The old generation stays valid until the new snapshot is closed
+  for (uint8_t sector = 0; sector < EEPROM_JOURNAL_SECTORS; ++sector) {
+    if (_state[sector] == SECTOR_CHAIN) {
+      _state[sector] = SECTOR_RETIRING;
+    }
+  }
+  _chainLength    = 0;
+  _generation     = ++_generationMax;
+  _compacting     = true;
+  _compactAddress = 0;
+}
+
+/* Writes the snapshot on until the next flash operation is done. The image may change in between, the changes are
+ * appended after the snapshot. */
+void EEPROMJournal::compactStep() {
+  uint32_t const operations = _operations;
+
+  while (_compacting && _operations == operations) {
+    if (_compactAddress < _size) {
+      size_t const length = (_size - _compactAddress > (size_t)EEPROM_JOURNAL_RECORD_DATA_MAX) ? EEPROM_JOURNAL_RECORD_DATA_MAX : _size - _compactAddress;
+      recordWrite(_compactAddress, &_image[_compactAddress], length);
+      _compactAddress += length;
+      continue;
+    }
+
+    recordWrite(RECORD_ADDRESS_END, nullptr, 0);
+    flush();
+
+    _compacting = false;
+    for (uint8_t sector = 0; sector < EEPROM_JOURNAL_SECTORS; ++sector) {
+      if (_state[sector] == SECTOR_RETIRING) {
+        _state[sector] = SECTOR_OBSOLETE;
+      }
+    }
+  }
+}
+
+void EEPROMJournal::erase() {
+  for (uint8_t sector = 0; sector < EEPROM_JOURNAL_SECTORS; ++sector) {
+    if (_state[sector] != SECTOR_ERASED) {
+      _sector_erase(sector * EEPROM_JOURNAL_SECTOR_SIZE);
+      _state[sector] = SECTOR_ERASED;
+    }
+  }
+  _chainLength = 0;
+  _compacting  = false;
+  _pageOffset  = PAGE_OFFSET_NONE;
+  _pageDirty   = false;
+}
+
+bool EEPROMJournal::maintenance() {
+  if (_image == nullptr) {
+    return false;
+  }
+
+  if (_compacting) {
+    compactStep();
+    return true;
+  }
+
+  for (uint8_t sector = 0; sector < EEPROM_JOURNAL_SECTORS; ++sector) {
+    if (_state[sector] == SECTOR_OBSOLETE) {
+      _sector_erase(sector * EEPROM_JOURNAL_SECTOR_SIZE);
+      _state[sector] = SECTOR_ERASED;
+      return true;
+    }
+  }
+
+  // Compact ahead of time, before a commit runs out of free sectors and has to do it itself
+  if (_chainLength != 0 && sectorsFree() <= SNAPSHOT_SECTORS + 1) {
+    compactStart();
+    compactStep();
+    return true;
+  }
+  return false;
+}
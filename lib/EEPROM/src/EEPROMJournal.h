@@ -0,0 +1,123 @@
+/*
+    EEPROMJournal.h - Log-structured flash backend of the RP2040 EEPROM emulation
+    Copyright (c) 2024 Dygma Lab S.L.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The journal spreads the EEPROM image over a ring of flash sectors instead of rewriting the same ones on every commit.
+ *
+ * A generation starts with a snapshot of the whole image, closed by an end marker, followed by the records of the
+ * changes committed since. Each record carries its address, length and CRC, so a record torn by a reset is detected and
+ * ignored. At boot the newest generation with a complete snapshot is replayed into the RAM mirror.
+ *
+ * Commits only program pages. Once the free sectors run low, the image is compacted into a new generation and the
+ * sectors of the old one are erased later by maintenance(), so the erases rotate over all the journal sectors. The
+ * snapshot is written one flash operation per maintenance() or append() call, the records of the commits made
+ * meanwhile are appended once it is closed.
+ */
+#define EEPROM_JOURNAL_SECTORS          16      // Flash sectors the journal rotates over
+#define EEPROM_JOURNAL_SECTOR_SIZE      4096    // Flash erase granularity
+#define EEPROM_JOURNAL_PAGE_SIZE        256     // Flash program granularity
+#define EEPROM_JOURNAL_SIZE             (EEPROM_JOURNAL_SECTORS * EEPROM_JOURNAL_SECTOR_SIZE)
+#define EEPROM_JOURNAL_RECORD_DATA_MAX  256     // Largest record payload, the snapshot is written in records this size
+#define EEPROM_JOURNAL_IMAGE_SIZE_MAX   8192
+
+class EEPROMJournal {
+ public:
+  // The offsets are relative to the journal start. The erase covers one sector, the program one page.
+  typedef void (*SectorEraseFn)(uint32_t offset);
+  typedef void (*PageProgramFn)(uint32_t offset, const uint8_t *data);
+
+  EEPROMJournal(const uint8_t *flash, SectorEraseFn sector_erase, PageProgramFn page_program);
+
+  bool begin(uint8_t *image, size_t size);  // Rebuilds the image, false if the journal holds no complete generation
+  bool append(uint16_t address, uint16_t length);  // False while compacting, the call did a step of it instead
+  void flush();
+  void compact();      // Writes a whole snapshot, or the rest of the one being written
+  void erase();        // Erases the journal, the next append() starts a new generation
+  bool maintenance();  // One step of background work, false if there was nothing to do
+
+  uint32_t getGeneration() const {
+    return _generation;
+  }
+
+ private:
+  struct SectorHeader {
+    uint32_t magic;
+    uint32_t generation;
+    uint16_t index;         // Position of the sector in the chain of its generation
+    uint16_t reserved;
+    uint32_t crc;
+  };
+
+  struct RecordHeader {
+    uint16_t address;
+    uint16_t length;
+    uint32_t crc;
+  };
+
+  enum SectorState : uint8_t {
+    SECTOR_ERASED,
+    SECTOR_CHAIN,           // Part of the current generation
+    SECTOR_RETIRING,        // Part of the generation being replaced by a compaction
+    SECTOR_OBSOLETE,        // Waiting to be erased
+  };
+
+  static constexpr uint32_t RECORDS_PER_SECTOR = (EEPROM_JOURNAL_SECTOR_SIZE - sizeof(SectorHeader)) /
+                                                 (sizeof(RecordHeader) + EEPROM_JOURNAL_RECORD_DATA_MAX);
+  static constexpr uint32_t SNAPSHOT_RECORDS   = EEPROM_JOURNAL_IMAGE_SIZE_MAX / EEPROM_JOURNAL_RECORD_DATA_MAX + 1;
+  static constexpr uint32_t SNAPSHOT_SECTORS   = (SNAPSHOT_RECORDS + RECORDS_PER_SECTOR - 1) / RECORDS_PER_SECTOR;
+
+  const uint8_t *_flash;
+  SectorEraseFn _sector_erase;
+  PageProgramFn _page_program;
+
+  uint8_t *_image = nullptr;
+  size_t _size    = 0;
+
+  uint32_t _generation    = 0;
+  uint32_t _generationMax = 0;
+  SectorState _state[EEPROM_JOURNAL_SECTORS];
+  uint8_t _chain[EEPROM_JOURNAL_SECTORS];
+  uint8_t _chainLength = 0;
+  uint8_t _lastSector  = EEPROM_JOURNAL_SECTORS - 1;
+  uint32_t _writeOffset = 0;
+  bool _compacting      = false;
+  size_t _compactAddress = 0;   // Next image address of the snapshot being written
+  uint32_t _operations  = 0;   // Flash operations done so far, a compaction step ends with the next one
+
+  uint8_t _page[EEPROM_JOURNAL_PAGE_SIZE];
+  uint32_t _pageOffset;
+  bool _pageDirty = false;
+
+  bool sectorHeaderRead(uint8_t sector, SectorHeader &header) const;
+  bool sectorBlank(uint8_t sector) const;
+  bool sectorReplay(uint8_t sector, bool apply, bool &snapshot_complete, uint32_t &end_offset);
+  uint8_t sectorTake();
+  bool sectorOpen();
+  uint8_t sectorsFree() const;
+  void compactStart();
+  void compactStep();
+  void write(uint32_t offset, const void *data, size_t len);
+  bool recordWrite(uint16_t address, const uint8_t *data, uint16_t length);
+  static uint32_t recordCrc(uint16_t address, uint16_t length, const uint8_t *data);
+};
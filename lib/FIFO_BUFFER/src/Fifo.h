@@ -0,0 +1,59 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2024  Dygma Lab S.L.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __FIFO_H__
+#define __FIFO_H__
+
+
+#include "Spsc_fifo_buffer.h"
+
+
+/*
+ * Typed SPSC FIFO of N items of the type T. The storage is a member, so its size is chosen at the place of use and is
+ * known at compile time (ram_size). Spsc_fifo_buffer::get_ram_total() reports the storage of all the queues at runtime.
+ */
+template <typename T, size_t N>
+class Fifo : public Spsc_fifo_buffer
+{
+    public:
+        static constexpr size_t ram_size = sizeof(T) * N;
+
+        Fifo() : Spsc_fifo_buffer(items, sizeof(T), N) {};
+
+        bool put(const T *item) { return Spsc_fifo_buffer::put(item); }
+        size_t get(T *item) { return Spsc_fifo_buffer::get(item); }
+        size_t peek(T *item) { return Spsc_fifo_buffer::peek(item); }
+
+        size_t put_n(const T *items, size_t count) { return Spsc_fifo_buffer::put_n(items, count); }
+        size_t get_n(T *items, size_t count) { return Spsc_fifo_buffer::get_n(items, count); }
+        size_t peek_span(T **pp_items) { return Spsc_fifo_buffer::peek_span(reinterpret_cast<void **>(pp_items)); }
+
+    private:
+        static_assert(N > 0, "The FIFO must hold at least one item");
+
+        T items[N];
+};
+
+
+#endif  // __FIFO_H__
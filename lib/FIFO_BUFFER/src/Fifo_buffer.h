@@ -28,40 +28,23 @@
 #define __FIFO_BUFFER_H__
 
 
-#include <stdint.h>
-#include <cstring>
+#include "Spsc_fifo_buffer.h"
 
 
-#define FIFO_BUFFER_DEBUG       0
-
 #define INTERNAL_BUFFER_SIZE    3000  // item_size x number of items of the FIFO in Bytes.
 
 
-class Fifo_buffer
+/*
+ * The FIFO of INTERNAL_BUFFER_SIZE Bytes for items of any size. It is the head/tail ring of Spsc_fifo_buffer, so
+ * get(), removeOne() and put() take the same time however full it is. The Fifo template sizes the storage to the use.
+ */
+class Fifo_buffer : public Spsc_fifo_buffer
 {
     public:
-        Fifo_buffer(size_t _item_size) : item_size(_item_size)
-        {
-            memset(internal_buffer, 0, INTERNAL_BUFFER_SIZE);
-        };
-
-        bool put(const void *cell);
-        size_t get(void *cell);
-        size_t peek(void *cell);
-        size_t removeOne();
-
-        bool is_empty(void);
-        bool is_full(void);
-        size_t get_num_items(void);
+        Fifo_buffer(size_t _item_size) : Spsc_fifo_buffer(internal_buffer, _item_size, INTERNAL_BUFFER_SIZE / _item_size) {};
 
     private:
-        size_t item_size;
-
         uint8_t internal_buffer[INTERNAL_BUFFER_SIZE];  // item_size x number of items of the FIFO Bytes.
-        int32_t index = 0;
-        int32_t num_items = 0;
-
-        void forward_fifo(void);
 };
 
 
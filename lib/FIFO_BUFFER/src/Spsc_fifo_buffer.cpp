@@ -0,0 +1,237 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2024  Dygma Lab S.L.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Spsc_fifo_buffer.h"
+
+#include "hardware/sync.h"
+
+
+/*
+ * The RP2040 has no data cache, both cores see the same memory. It is enough to keep the order of the accesses, which
+ * the DMB provides for the CPU and the compiler as well.
+ */
+#define SPSC_FIFO_BARRIER()     __dmb()
+
+
+size_t Spsc_fifo_buffer::ram_total = 0;
+
+bool Spsc_fifo_buffer::put(const void *item)
+{
+    size_t _tail = tail;
+
+    if (count(head, _tail) >= capacity) return false;  // Fifo full.
+
+    memcpy(item_at(_tail), item, item_size);
+
+    SPSC_FIFO_BARRIER();  // The item must be stored before the consumer can see it.
+    tail = advance(_tail);
+
+    return true;
+}
+
+size_t Spsc_fifo_buffer::get(void *item)
+{
+    if (peek(item) == 0) return 0;
+
+    SPSC_FIFO_BARRIER();  // The item must be read before the producer can overwrite it.
+    head = advance(head);
+
+    return item_size;
+}
+
+size_t Spsc_fifo_buffer::peek(void *item)
+{
+    size_t _head = head;
+
+    if (count(_head, tail) == 0)
+    {
+        memset(item, 0, item_size);
+        return 0;
+    }
+
+    SPSC_FIFO_BARRIER();  // The tail must be read before the item it publishes.
+    memcpy(item, item_at(_head), item_size);  // Reads item.
+
+    return item_size;
+}
+
+size_t Spsc_fifo_buffer::removeOne()
+{
+    size_t _head = head;
+
+    if (count(_head, tail) == 0) return 0;
+
+    SPSC_FIFO_BARRIER();
+    head = advance(_head);
+
+    return item_size;
+}
+
+void Spsc_fifo_buffer::clear(void)
+{
+    // Drops all the items the producer has published so far.
+    size_t _tail = tail;
+
+    SPSC_FIFO_BARRIER();
+    head = _tail;
+}
+
+size_t Spsc_fifo_buffer::put_n(const void *items, size_t items_count)
+{
+    const uint8_t *p_items = static_cast<const uint8_t *>(items);
+    size_t _tail = tail;
+    size_t free_count = capacity - count(head, _tail);
+    size_t chunk;
+
+    if (items_count > free_count) items_count = free_count;
+
+    // The items may wrap around the end of the storage, so they are copied in up to two chunks.
+    chunk = contiguous(_tail, items_count);
+    memcpy(item_at(_tail), p_items, chunk * item_size);
+    memcpy(item_at(advance(_tail, chunk)), p_items + chunk * item_size, (items_count - chunk) * item_size);
+
+    SPSC_FIFO_BARRIER();  // The items must be stored before the consumer can see them.
+    tail = advance(_tail, items_count);
+
+    return items_count;
+}
+
+size_t Spsc_fifo_buffer::get_n(void *items, size_t items_count)
+{
+    uint8_t *p_items = static_cast<uint8_t *>(items);
+    size_t _head = head;
+    size_t used_count = count(_head, tail);
+    size_t chunk;
+
+    if (items_count > used_count) items_count = used_count;
+
+    SPSC_FIFO_BARRIER();  // The tail must be read before the items it publishes.
+
+    chunk = contiguous(_head, items_count);
+    memcpy(p_items, item_at(_head), chunk * item_size);
+    memcpy(p_items + chunk * item_size, item_at(advance(_head, chunk)), (items_count - chunk) * item_size);
+
+    SPSC_FIFO_BARRIER();  // The items must be read before the producer can overwrite them.
+    head = advance(_head, items_count);
+
+    return items_count;
+}
+
+size_t Spsc_fifo_buffer::remove_n(size_t items_count)
+{
+    size_t _head = head;
+    size_t used_count = count(_head, tail);
+
+    if (items_count > used_count) items_count = used_count;
+
+    SPSC_FIFO_BARRIER();
+    head = advance(_head, items_count);
+
+    return items_count;
+}
+
+size_t Spsc_fifo_buffer::peek_span(void **pp_items)
+{
+    size_t _head = head;
+    size_t used_count = count(_head, tail);
+
+    SPSC_FIFO_BARRIER();  // The tail must be read before the items it publishes.
+
+    *pp_items = item_at(_head);
+
+    return contiguous(_head, used_count);
+}
+
+void Spsc_fifo_buffer::clear_request(void)
+{
+    clear_tail = tail;
+
+    SPSC_FIFO_BARRIER();  // The position must be stored before the consumer can see the request.
+    clear_requests = clear_requests + 1;
+}
+
+size_t Spsc_fifo_buffer::clear_apply(void)
+{
+    uint32_t _clear_requests = clear_requests;
+    size_t _head = head;
+    size_t clear_count;
+
+    if (_clear_requests == clear_done) return 0;
+
+    SPSC_FIFO_BARRIER();  // The request must be read before the position it publishes.
+    clear_count = count(_head, clear_tail);
+    clear_done = _clear_requests;
+
+    // The consumer has already taken the marked items, and maybe some put after the request. There is nothing left to drop.
+    if (clear_count > count(_head, tail)) return 0;
+
+    return remove_n(clear_count);
+}
+
+bool Spsc_fifo_buffer::is_empty(void)
+{
+    return count(head, tail) == 0;
+}
+
+bool Spsc_fifo_buffer::is_full(void)
+{
+    return count(head, tail) >= capacity;
+}
+
+size_t Spsc_fifo_buffer::get_num_items(void)
+{
+    return count(head, tail);
+}
+
+size_t Spsc_fifo_buffer::advance(size_t position, size_t items)
+{
+    position += items;
+    if (position >= 2 * capacity) position -= 2 * capacity;
+
+    return position;
+}
+
+size_t Spsc_fifo_buffer::count(size_t _head, size_t _tail)
+{
+    if (_tail >= _head) return _tail - _head;
+
+    return _tail + 2 * capacity - _head;
+}
+
+size_t Spsc_fifo_buffer::contiguous(size_t position, size_t items)
+{
+    // How many of the items starting at the position are stored before the end of the storage.
+    if (position >= capacity) position -= capacity;
+
+    if (items > capacity - position) return capacity - position;
+
+    return items;
+}
+
+uint8_t *Spsc_fifo_buffer::item_at(size_t position)
+{
+    if (position >= capacity) position -= capacity;
+
+    return storage + position * item_size;
+}
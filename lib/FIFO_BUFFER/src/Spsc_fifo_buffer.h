@@ -0,0 +1,100 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2024  Dygma Lab S.L.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SPSC_FIFO_BUFFER_H__
+#define __SPSC_FIFO_BUFFER_H__
+
+
+#include <stdint.h>
+#include <cstring>
+
+
+/*
+ * Lock-free ring buffer for exactly one producer and one consumer. The producer and the consumer may run
+ * in different contexts - thread and interrupt, or the two cores.
+ *
+ * The producer owns the tail and calls put(), put_n(), is_full() and clear_request(), the consumer owns the head and calls get(),
+ * get_n(), peek(), peek_span(), removeOne(), remove_n(), clear(), clear_apply() and is_empty(). get_num_items() is a snapshot which
+ * can be taken from both sides.
+ */
+class Spsc_fifo_buffer
+{
+    public:
+        // The storage of _capacity x _item_size Bytes is provided by the owner, see the Fifo template.
+        Spsc_fifo_buffer(void *_storage, size_t _item_size, size_t _capacity)
+            : item_size(_item_size), capacity(_capacity), storage(static_cast<uint8_t *>(_storage))
+        {
+            memset(storage, 0, item_size * capacity);
+            ram_total += item_size * capacity;
+        };
+
+        bool put(const void *item);
+        size_t get(void *item);
+        size_t peek(void *item);
+        size_t removeOne();
+        void clear(void);
+
+        // Batch operations. They move as many of the count items as possible and return the number of items moved.
+        size_t put_n(const void *items, size_t count);
+        size_t get_n(void *items, size_t count);
+        size_t remove_n(size_t count);
+
+        // Provides the pointer to the oldest items in the storage and returns how many of them are stored contiguously.
+        // The items stay in the FIFO, and the consumer may work on them in place, until they are removed.
+        size_t peek_span(void **pp_items);
+
+        // The producer side clear. It only marks the items put so far, the consumer drops them with its next clear_apply().
+        void clear_request(void);
+        size_t clear_apply(void);
+
+        bool is_empty(void);
+        bool is_full(void);
+        size_t get_num_items(void);
+
+        // The storage of all the queues constructed so far in Bytes.
+        static size_t get_ram_total(void) { return ram_total; }
+
+    private:
+        size_t item_size;
+        size_t capacity;  // Number of items which fit in the storage.
+
+        uint8_t *storage;  // item_size x capacity Bytes.
+        static size_t ram_total;
+
+        // The positions run over twice the capacity, so the full and the empty FIFO can be told apart without a shared counter.
+        volatile size_t head = 0;  // Written by the consumer only.
+        volatile size_t tail = 0;  // Written by the producer only.
+
+        volatile size_t clear_tail = 0;      // Written by the producer only.
+        volatile uint32_t clear_requests = 0;  // Written by the producer only.
+        uint32_t clear_done = 0;               // Written by the consumer only.
+
+        size_t advance(size_t position, size_t items = 1);
+        size_t count(size_t _head, size_t _tail);
+        size_t contiguous(size_t position, size_t items);
+        uint8_t *item_at(size_t position);
+};
+
+
+#endif  // __SPSC_FIFO_BUFFER_H__
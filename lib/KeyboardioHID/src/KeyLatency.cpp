@@ -0,0 +1,166 @@
+/*
+Copyright (c) 2024 Dygmalab S.L.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <string.h>
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "KeyLatency.h"
+
+struct LatencyHistogram
+{
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[KEY_LATENCY_BUCKETS_COUNT];
+};
+
+static LatencyHistogram queueHistogram;
+static LatencyHistogram totalHistogram;
+
+/* Written by the SPI slave, possibly from its interrupt, and taken over from the loop. */
+static volatile bool keyTimePending = false;
+static volatile uint32_t keyTimeUs;
+
+static void histogramRecord(LatencyHistogram *histogram, uint32_t latency_us)
+{
+    uint32_t bucket = latency_us / KEY_LATENCY_BUCKET_US;
+
+    if (bucket >= KEY_LATENCY_BUCKETS_COUNT)
+    {
+        bucket = KEY_LATENCY_BUCKETS_COUNT - 1;
+    }
+
+    if (histogram->count == 0 || latency_us < histogram->min_us)
+    {
+        histogram->min_us = latency_us;
+    }
+    if (latency_us > histogram->max_us)
+    {
+        histogram->max_us = latency_us;
+    }
+    histogram->count++;
+    histogram->sum_us += latency_us;
+    histogram->buckets[bucket]++;
+}
+
+static void histogramStatsGet(const LatencyHistogram *histogram, KeyLatency::Stats &stats)
+{
+    uint32_t p99_count;
+    uint32_t count = 0;
+    uint32_t bucket;
+
+    memset(&stats, 0, sizeof(stats));
+    if (histogram->count == 0)
+    {
+        return;
+    }
+
+    stats.count = histogram->count;
+    stats.min_us = histogram->min_us;
+    stats.max_us = histogram->max_us;
+    stats.avg_us = (uint32_t)(histogram->sum_us / histogram->count);
+
+    /* Find the bucket where the cumulative count reaches 99 % of the samples */
+    p99_count = (uint32_t)(((uint64_t)histogram->count * 99 + 99) / 100);
+    for (bucket = 0; bucket < KEY_LATENCY_BUCKETS_COUNT - 1; bucket++)
+    {
+        count += histogram->buckets[bucket];
+        if (count >= p99_count)
+        {
+            break;
+        }
+    }
+
+    stats.p99_us = (bucket + 1) * KEY_LATENCY_BUCKET_US;
+    if (stats.p99_us > stats.max_us)
+    {
+        stats.p99_us = stats.max_us;
+    }
+}
+
+void KeyLatency::keyPacketReceived()
+{
+    /* Keep the oldest one, the following packets are part of the same backlog */
+    if (keyTimePending)
+    {
+        return;
+    }
+
+    keyTimeUs = time_us_32();
+    __dmb();
+    keyTimePending = true;
+}
+
+bool KeyLatency::keyTimeClaim(uint32_t &key_time_us)
+{
+    if (!keyTimePending)
+    {
+        return false;
+    }
+
+    key_time_us = keyTimeUs;
+    __dmb();
+    keyTimePending = false;
+    return true;
+}
+
+void KeyLatency::keyTimeDiscard()
+{
+    keyTimePending = false;
+}
+
+void KeyLatency::reportQueued(uint32_t key_time_us)
+{
+    uint32_t status = save_and_disable_interrupts();
+    histogramRecord(&queueHistogram, time_us_32() - key_time_us);
+    restore_interrupts(status);
+}
+
+void KeyLatency::reportDelivered(uint32_t key_time_us)
+{
+    uint32_t status = save_and_disable_interrupts();
+    histogramRecord(&totalHistogram, time_us_32() - key_time_us);
+    restore_interrupts(status);
+}
+
+void KeyLatency::getQueueStats(Stats &stats)
+{
+    uint32_t status = save_and_disable_interrupts();
+    histogramStatsGet(&queueHistogram, stats);
+    restore_interrupts(status);
+}
+
+void KeyLatency::getTotalStats(Stats &stats)
+{
+    uint32_t status = save_and_disable_interrupts();
+    histogramStatsGet(&totalHistogram, stats);
+    restore_interrupts(status);
+}
+
+void KeyLatency::resetStats()
+{
+    uint32_t status = save_and_disable_interrupts();
+    memset(&queueHistogram, 0, sizeof(queueHistogram));
+    memset(&totalHistogram, 0, sizeof(totalHistogram));
+    restore_interrupts(status);
+}
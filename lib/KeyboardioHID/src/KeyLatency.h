@@ -0,0 +1,62 @@
+/*
+Copyright (c) 2024 Dygmalab S.L.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Measures how long a keypress spends inside the Neuron. A key packet is timestamped when the SPI slave accepts it, the
+ * first keyboard report sent after it takes the timestamp over, and the latency is recorded once the report complete
+ * callback confirms the report reached the host.
+ *
+ * Two histograms are kept: "queue" from the packet arrival to the report being handed to the HID layer, and "total" from
+ * the packet arrival to the USB delivery.
+ */
+#define KEY_LATENCY_BUCKET_US       100     /* Width of one histogram bucket */
+#define KEY_LATENCY_BUCKETS_COUNT   100     /* The last bucket also collects everything above its range */
+
+class KeyLatency {
+ public:
+
+  struct Stats {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t p99_us;    /* Upper edge of the bucket holding the 99th percentile, at most max_us */
+    uint32_t max_us;
+  };
+
+  /* Called by the SPI slave for every accepted key packet. Keeps the oldest timestamp until a report takes it over. */
+  static void keyPacketReceived();
+  /* Takes over the pending key packet timestamp, if any. */
+  static bool keyTimeClaim(uint32_t &key_time_us);
+  /* Drops the pending timestamp, so a key packet that changed no keyboard report is not charged to a later report. */
+  static void keyTimeDiscard();
+
+  static void reportQueued(uint32_t key_time_us);
+  static void reportDelivered(uint32_t key_time_us);
+
+  static void getQueueStats(Stats &stats);
+  static void getTotalStats(Stats &stats);
+  static void resetStats();
+};
@@ -93,7 +93,7 @@ void Keyboard_::end() {
 }
 
 int Keyboard_::sendReportUnchecked() {
-  return HID().SendReport(HID_REPORTID_NKRO_KEYBOARD,&last_report_, sizeof(last_report_));
+  return HID().SendReport(HID_REPORTID_NKRO_KEYBOARD, &last_state_.modifiers, sizeof(HID_KeyboardReport_Data_t));
 }
 
 // Sending the current HID report to the host:
@@ -122,38 +122,39 @@ int Keyboard_::sendReportUnchecked() {
 // 3. A report with toggled-on non-modifiers added.
 
 int Keyboard_::sendReport() {
+  // One pass over the key words tells which of the three reports are needed:
+  // whether any non-modifier toggled off, and whether any toggled on.
+  uint32_t released_keycodes = 0;
+  uint32_t pressed_keycodes = 0;
+
+  for (uint8_t i = 0; i < KEY_WORDS; ++i) {
+    released_keycodes |= last_state_.keys[i] & ~state_.keys[i];
+    pressed_keycodes |= state_.keys[i] & ~last_state_.keys[i];
+  }
+
   // If the new HID report differs from the previous one both in active modifier
   // keycodes and non-modifier keycodes, we will need to send at least one extra
-  // report. First, we compare the modifiers bytes of the two reports.
-  const uint8_t old_modifiers = last_report_.modifiers;
-  const uint8_t new_modifiers = report_.modifiers;
-
-  const uint8_t changed_modifiers = old_modifiers ^ new_modifiers;
-
-  if (changed_modifiers != 0) {
+  // report.
+  if (last_state_.modifiers != state_.modifiers) {
     // There was at least one modifier change (toggled on or off), remove any
     // non-modifiers from the stored previous report that toggled off in the new
     // report, and send it to the host.
-    bool non_modifiers_toggled_off = false;
-    for (uint8_t i = 0; i < KEY_BYTES; ++i) {
-      byte released_keycodes = last_report_.keys[i] & ~(report_.keys[i]);
-      if (released_keycodes != 0) {
-        last_report_.keys[i] &= ~released_keycodes;
-        non_modifiers_toggled_off = true;
+    if (released_keycodes != 0) {
+      for (uint8_t i = 0; i < KEY_WORDS; ++i) {
+        last_state_.keys[i] &= state_.keys[i];
       }
-    }
-    if (non_modifiers_toggled_off) {
+      released_keycodes = 0;
       sendReportUnchecked();
     }
     // Next, update the modifiers byte of the stored previous report, and send
     // it.
-    last_report_.modifiers = new_modifiers;
+    last_state_.modifiers = state_.modifiers;
     sendReportUnchecked();
   }
 
   // Finally, copy the new report to the previous one, and send it.
-  if (memcmp(last_report_.keys, report_.keys, sizeof(report_.keys)) != 0) {
-    memcpy(last_report_.keys, report_.keys, sizeof(report_.keys));
+  if ((released_keycodes | pressed_keycodes) != 0) {
+    memcpy(last_state_.keys, state_.keys, sizeof(state_.keys));
     return sendReportUnchecked();
   }
   // A note on return values: Kaleidoscope doesn't actually check the return
@@ -172,7 +173,7 @@ int Keyboard_::sendReport() {
 bool Keyboard_::isModifierActive(uint8_t k) {
   if (k >= HID_KEYBOARD_FIRST_MODIFIER && k <= HID_KEYBOARD_LAST_MODIFIER) {
     k = k - HID_KEYBOARD_FIRST_MODIFIER;
-    return !!(report_.modifiers & (1 << k));
+    return !!(state_.modifiers & (1 << k));
   }
   return false;
 }
@@ -183,7 +184,7 @@ bool Keyboard_::isModifierActive(uint8_t k) {
 bool Keyboard_::wasModifierActive(uint8_t k) {
   if (k >= HID_KEYBOARD_FIRST_MODIFIER && k <= HID_KEYBOARD_LAST_MODIFIER) {
     k = k - HID_KEYBOARD_FIRST_MODIFIER;
-    return !!(last_report_.modifiers & (1 << k));
+    return !!(last_state_.modifiers & (1 << k));
   }
   return false;
 }
@@ -192,14 +193,14 @@ bool Keyboard_::wasModifierActive(uint8_t k) {
  * Returns false in all other cases
  * */
 bool Keyboard_::isAnyModifierActive() {
-  return report_.modifiers > 0;
+  return state_.modifiers > 0;
 }
 
 /* Returns true if *any* modifier was being sent during the previous key report
  * Returns false in all other cases
  * */
 bool Keyboard_::wasAnyModifierActive() {
-  return last_report_.modifiers > 0;
+  return last_state_.modifiers > 0;
 }
 
 uint8_t Keyboard_::getLEDs()
@@ -212,8 +213,7 @@ uint8_t Keyboard_::getLEDs()
  * */
 bool Keyboard_::isKeyPressed(uint8_t k) {
   if (k <= HID_LAST_KEY) {
-    uint8_t bit = 1 << (uint8_t(k) % 8);
-    return !!(report_.keys[k / 8] & bit);
+    return !!(state_.keys[k / 32] & (1UL << (k % 32)));
   }
   return false;
 }
@@ -224,8 +224,7 @@ bool Keyboard_::isKeyPressed(uint8_t k) {
 bool Keyboard_::wasKeyPressed(uint8_t k) {
 
   if (k <= HID_LAST_KEY) {
-    uint8_t bit = 1 << (uint8_t(k) % 8);
-    return !!(last_report_.keys[k / 8] & bit);
+    return !!(last_state_.keys[k / 32] & (1UL << (k % 32)));
   }
   return false;
 }
@@ -234,8 +233,7 @@ bool Keyboard_::wasKeyPressed(uint8_t k) {
 size_t Keyboard_::press(uint8_t k) {
   // If the key is in the range of 'printable' keys
   if (k <= HID_LAST_KEY) {
-    uint8_t bit = 1 << (uint8_t(k) % 8);
-    report_.keys[k / 8] |= bit;
+    state_.keys[k / 32] |= 1UL << (k % 32);
     return 1;
   }
 
@@ -243,7 +241,7 @@ size_t Keyboard_::press(uint8_t k) {
   else if (k >= HID_KEYBOARD_FIRST_MODIFIER && k <= HID_KEYBOARD_LAST_MODIFIER) {
     // Convert key into bitfield (0 - 7)
     k = k - HID_KEYBOARD_FIRST_MODIFIER;
-    report_.modifiers |= (1 << k);
+    state_.modifiers |= (1 << k);
     return 1;
   }
 
@@ -254,8 +252,7 @@ size_t Keyboard_::press(uint8_t k) {
 size_t Keyboard_::release(uint8_t k) {
   // If we're releasing a printable key
   if (k <= HID_LAST_KEY) {
-    uint8_t bit = 1 << (k % 8);
-    report_.keys[k / 8] &= ~bit;
+    state_.keys[k / 32] &= ~(1UL << (k % 32));
     return 1;
   }
 
@@ -263,7 +260,7 @@ size_t Keyboard_::release(uint8_t k) {
   else if (k >= HID_KEYBOARD_FIRST_MODIFIER && k <= HID_KEYBOARD_LAST_MODIFIER) {
     // Convert key into bitfield (0 - 7)
     k = k - HID_KEYBOARD_FIRST_MODIFIER;
-    report_.modifiers &= ~(1 << k);
+    state_.modifiers &= ~(1 << k);
     return 1;
   }
 
@@ -273,7 +270,7 @@ size_t Keyboard_::release(uint8_t k) {
 
 void Keyboard_::releaseAll() {
   // Release all keys
-  memset(&report_.allkeys, 0x00, sizeof(report_.allkeys));
+  memset(&state_, 0x00, sizeof(state_));
 }
 
 Keyboard_ Keyboard;
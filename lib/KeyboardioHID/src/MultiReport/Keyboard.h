@@ -29,12 +29,14 @@ THE SOFTWARE.
 #include "HID-Settings.h"
 #include "hidDefy.h"
 #include <Arduino.h>
+#include <stddef.h>
 
 #include "HIDAliases.h"
 #include "HIDTables.h"
 
 #define KEY_BITS (4 + HID_LAST_KEY - HID_KEYBOARD_A_AND_A + 1)
 #define KEY_BYTES ((KEY_BITS + 7) / 8)
+#define KEY_WORDS ((KEY_BYTES + 3) / 4)
 
 // clang-format off
 // Keyboard Report Descriptor Template
@@ -85,6 +87,21 @@ typedef union
     uint8_t allkeys[1 + KEY_BYTES];
 } HID_KeyboardReport_Data_t;
 
+// The key state is kept word aligned, so it can be compared and masked a word at a time. Keycode k is bit (k % 32) of
+// keys[k / 32], which on the little-endian MCU has the same memory layout as the keys[] of the report. The modifiers
+// sit right in front of the keys, so the state from the modifiers on is the report as it is sent.
+typedef struct
+{
+    uint8_t reserved[3];
+    uint8_t modifiers;
+    uint32_t keys[KEY_WORDS];
+} Keyboard_KeyState_t;
+
+static_assert(offsetof(Keyboard_KeyState_t, keys) == offsetof(Keyboard_KeyState_t, modifiers) + 1,
+              "The key state must have the layout of the report");
+static_assert(sizeof(Keyboard_KeyState_t) - offsetof(Keyboard_KeyState_t, modifiers) >= sizeof(HID_KeyboardReport_Data_t),
+              "The key state must hold the whole report");
+
 
 class Keyboard_
 {
@@ -108,8 +125,8 @@ class Keyboard_
     uint8_t getLEDs();
 
   private:
-    HID_KeyboardReport_Data_t report_;
-    HID_KeyboardReport_Data_t last_report_;
+    Keyboard_KeyState_t state_;
+    Keyboard_KeyState_t last_state_;
 
     int sendReportUnchecked();
 };
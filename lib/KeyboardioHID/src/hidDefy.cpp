@@ -28,12 +28,19 @@ THE SOFTWARE.
 #include "DescriptorPrimitives.h"
 #include "HIDAliases.h"
 #include "HIDReportObserver.h"
+#include "KeyLatency.h"
 #include "MultiReport/Keyboard.h"
+#include "MultiReport/Mouse.h"
+#include "MultiReport/ConsumerControl.h"
+#include "Fifo.h"
 
 /*
  * Extern functions for providing the HID report descriptor. Needs to be defined on the application level.
  */
 extern void hid_report_descriptor_usb_get( const uint8_t ** pp_desc, uint32_t * p_desc_len );
+#if HID_DEFY_SPLIT_INTERFACES
+extern void hid_report_descriptor_usb_pointer_get( const uint8_t ** pp_desc, uint32_t * p_desc_len );
+#endif
 
 HID_ &HID()
 {
@@ -59,16 +66,134 @@ int HID_::SendReport(uint8_t id, const void *data, int len)
 }
 
 
-tu_fifo_t tx_ff_hid;
+/*
+ * The reports waiting for the endpoint, in order. The longest queued report is the NKRO keyboard one, the consumer and
+ * system control reports have their latest report slots below and the mouse reports are accumulated.
+ */
+#define QUEUED_REPORT_SIZE_MAX  sizeof(HID_KeyboardReport_Data_t)
+
+struct QueuedReport
+{
+    uint8_t id;
+    uint8_t len;
+    bool keyTimed;          // The report was produced by a timestamped key packet
+    uint32_t keyTimeUs;
+    uint8_t data[QUEUED_REPORT_SIZE_MAX];
+};
+
+// Only the keyboard reports, and the mouse reports closed by a button change, are queued here. A macro typing 32
+// characters queues 64 reports, a press and a release each, within a few ms while the endpoint drains one per frame.
+static Fifo<QueuedReport, 64> reportQueue;
+
+#if HID_DEFY_SPLIT_INTERFACES
+// With the pointer reports on their own interface, the mouse reports closed by a button change are queued here instead.
+static Fifo<QueuedReport, 16> reportQueuePointer;
+#endif
+
+// The timestamp of the keyboard report being delivered, recorded once the report complete callback fires.
+static volatile bool keyReportInFlight = false;
+static volatile uint32_t keyReportInFlightTimeUs;
+
+/*
+ * Mouse reports are not queued one by one. While the endpoint is busy, their movement is summed up here and sent as one
+ * report once the endpoint frees up. The sums are wider than the report fields, so no movement is lost when clamping.
+ */
+struct MouseAccumulator
+{
+    bool pending;
+    uint8_t buttons;
+    int32_t xAxis;
+    int32_t yAxis;
+    int32_t vWheel;
+    int32_t hWheel;
+};
+
+static MouseAccumulator mouseAccumulator;
+
+/*
+ * Consumer and system control reports describe a state, only the newest one matters. Each of them has its own slot instead
+ * of waiting behind the queued keyboard reports. The slot keeps the report being sent and the one following it, so a press
+ * and release within one USB frame still both reach the host; any further change in the meantime replaces the following one.
+ */
+#define LATEST_REPORT_SIZE_MAX  sizeof(HID_ConsumerControlReport_Data_t)
 
-uint8_t tx_ff_buf_hid[8000];
+struct LatestReportValue
+{
+    bool dirty;
+    uint8_t len;
+    uint8_t data[LATEST_REPORT_SIZE_MAX];
+};
 
-struct NextReport
+struct LatestReport
 {
     uint8_t id;
-    uint16_t len;
+    LatestReportValue current;
+    LatestReportValue following;
 };
 
+static LatestReport latestReports[] =
+{
+    { HID_REPORTID_CONSUMERCONTROL, {}, {} },
+    { HID_REPORTID_SYSTEMCONTROL, {}, {} },
+};
+
+static LatestReport *latestReportFind(uint8_t id, int len)
+{
+    if (len > (int)LATEST_REPORT_SIZE_MAX) return nullptr;
+
+    for (auto &latestReport : latestReports)
+    {
+        if (latestReport.id == id) return &latestReport;
+    }
+    return nullptr;
+}
+
+static LatestReport *latestReportDirtyGet()
+{
+    for (auto &latestReport : latestReports)
+    {
+        if (latestReport.current.dirty) return &latestReport;
+    }
+    return nullptr;
+}
+
+static void latestReportStore(LatestReport *latestReport, const void *data, int len)
+{
+    LatestReportValue *value = latestReport->current.dirty ? &latestReport->following : &latestReport->current;
+
+    memcpy(value->data, data, len);
+    value->len = static_cast<uint8_t>(len);
+    value->dirty = true;
+}
+
+static int8_t mouseAxisClamp(int32_t value)
+{
+    if (value > 127) return 127;
+    if (value < -127) return -127;
+    return static_cast<int8_t>(value);
+}
+
+static void mouseReportGet(HID_MouseReport_Data_t *report)
+{
+    report->buttons = mouseAccumulator.buttons;
+    report->xAxis = mouseAxisClamp(mouseAccumulator.xAxis);
+    report->yAxis = mouseAxisClamp(mouseAccumulator.yAxis);
+    report->vWheel = mouseAxisClamp(mouseAccumulator.vWheel);
+    report->hWheel = mouseAxisClamp(mouseAccumulator.hWheel);
+}
+
+static void mouseReportConsume(const HID_MouseReport_Data_t *report)
+{
+    // Whatever did not fit into the report stays for the next one.
+    mouseAccumulator.xAxis -= report->xAxis;
+    mouseAccumulator.yAxis -= report->yAxis;
+    mouseAccumulator.vWheel -= report->vWheel;
+    mouseAccumulator.hWheel -= report->hWheel;
+
+    mouseAccumulator.pending = mouseAccumulator.xAxis != 0 || mouseAccumulator.yAxis != 0 ||
+                               mouseAccumulator.vWheel != 0 || mouseAccumulator.hWheel != 0;
+}
+
 int HID_::SendReport_(uint8_t id, const void *data, int len)
 {
     /* On SAMD, we need to send the whole report in one batch; sending the id, and
@@ -105,15 +230,39 @@ int HID_::SendReport_(uint8_t id, const void *data, int len)
     }
     else if (TinyUSBDevice.mounted())
     {
-        if(id==HID_REPORTID_MOUSE)
+        LatestReport *latestReport = latestReportFind(id, len);
+        uint32_t keyTimeUs = 0;
+        bool keyTimed = false;
+
+        // The first keyboard report after a key packet carries its timestamp through to the delivery.
+        if (id == HID_REPORTID_NKRO_KEYBOARD)
         {
-            usb_hid.sendReport(id, (uint8_t *const)data, len);
-            return 1;
+            keyTimed = KeyLatency::keyTimeClaim(keyTimeUs);
+            if (keyTimed)
+            {
+                KeyLatency::reportQueued(keyTimeUs);
+            }
         }
+
         mutex_enter_blocking(&reportMutex);
-        NextReport nextReport{id, static_cast<uint16_t>(len)};
-        tu_fifo_write_n(&tx_ff_hid, &nextReport, (uint16_t)(sizeof(nextReport)));
-        tu_fifo_write_n(&tx_ff_hid, data, (uint16_t)len);
+        if (id == HID_REPORTID_MOUSE)
+        {
+            MouseAccumulate(data, len);
+        }
+        else if (latestReport != nullptr)
+        {
+            latestReportStore(latestReport, data, len);
+        }
+        else
+        {
+            QueueReport(&reportQueue, id, data, len, keyTimed, keyTimeUs);
+        }
+
+        // If the endpoint is idle, there is no report complete callback to come. Start the draining right away.
+        if (EndpointReady())
+        {
+            SendQueuedReport();
+        }
         mutex_exit(&reportMutex);
     }
 
@@ -127,29 +276,199 @@ int HID_::SendReport_(uint8_t id, const void *data, int len)
 
 bool HID_::SendLastReport()
 {
-    bool success = true;
+    bool success;
+
+    // The queue is drained from the report complete callback. This is the fallback for the reports the callback could not take.
     mutex_enter_blocking(&reportMutex);
-    if (tu_fifo_count(&tx_ff_hid) != 0)
+    success = SendQueuedReport();
+    mutex_exit(&reportMutex);
+    return success;
+}
+
+void HID_::ReportComplete(uint8_t id)
+{
+    // Called from the USB stack once the endpoint is free again. When the queue is being modified right now, leave the
+    // report for the SendLastReport() from the loop() instead of blocking the USB stack.
+    uint32_t owner;
+
+    if (id == HID_REPORTID_NKRO_KEYBOARD && keyReportInFlight)
+    {
+        keyReportInFlight = false;
+        KeyLatency::reportDelivered(keyReportInFlightTimeUs);
+    }
+
+    if (!mutex_try_enter(&reportMutex, &owner))
+    {
+        return;
+    }
+    SendQueuedReport();
+    mutex_exit(&reportMutex);
+}
+
+// The reportMutex must be held by the caller. It also serializes the two sides of the queue, so the oldest report can be
+// dropped from here when the queue is full; the newest one describes the current state of the keys.
+void HID_::QueueReport(Spsc_fifo_buffer *queue, uint8_t id, const void *data, int len, bool keyTimed, uint32_t keyTimeUs)
+{
+    QueuedReport queuedReport;
+
+    if (len > (int)QUEUED_REPORT_SIZE_MAX) return;
+
+    queuedReport.id = id;
+    queuedReport.len = static_cast<uint8_t>(len);
+    queuedReport.keyTimed = keyTimed;
+    queuedReport.keyTimeUs = keyTimeUs;
+    memcpy(queuedReport.data, data, len);
+
+    if (queue->is_full())
+    {
+        queue->removeOne();
+    }
+    queue->put(&queuedReport);
+}
+
+// The reportMutex must be held by the caller.
+void HID_::MouseAccumulate(const void *data, int len)
+{
+    const HID_MouseReport_Data_t *report = static_cast<const HID_MouseReport_Data_t *>(data);
+    HID_MouseReport_Data_t accumulatedReport;
+#if HID_DEFY_SPLIT_INTERFACES
+    Spsc_fifo_buffer *queue = &reportQueuePointer;
+#else
+    Spsc_fifo_buffer *queue = &reportQueue;
+#endif
+
+    if (len != sizeof(HID_MouseReport_Data_t))
+    {
+        QueueReport(queue, HID_REPORTID_MOUSE, data, len);
+        return;
+    }
+
+    // A button change closes the accumulated report, so no click can be merged away. The closed report joins the ordered
+    // queue, split into more reports if its movement does not fit into one.
+    if (mouseAccumulator.pending && report->buttons != mouseAccumulator.buttons)
+    {
+        while (mouseAccumulator.pending)
+        {
+            mouseReportGet(&accumulatedReport);
+            QueueReport(queue, HID_REPORTID_MOUSE, &accumulatedReport, sizeof(accumulatedReport));
+            mouseReportConsume(&accumulatedReport);
+        }
+    }
+
+    mouseAccumulator.buttons = report->buttons;
+    mouseAccumulator.xAxis += report->xAxis;
+    mouseAccumulator.yAxis += report->yAxis;
+    mouseAccumulator.vWheel += report->vWheel;
+    mouseAccumulator.hWheel += report->hWheel;
+    mouseAccumulator.pending = true;
+}
+
+// The reportMutex must be held by the caller.
+bool HID_::SendMouseReport(Adafruit_USBD_HID &hid)
+{
+    HID_MouseReport_Data_t report;
+    bool success;
+
+    mouseReportGet(&report);
+    success = hid.sendReport(HID_REPORTID_MOUSE, &report, sizeof(report));
+
+    if (success || TinyUSBDevice.suspended())
+    {
+        mouseReportConsume(&report);
+    }
+    return success;
+}
+
+bool HID_::EndpointReady()
+{
+#if HID_DEFY_SPLIT_INTERFACES
+    return usb_hid.ready() || usb_hid_pointer.ready();
+#else
+    return usb_hid.ready();
+#endif
+}
+
+// The reportMutex must be held by the caller.
+bool HID_::SendQueuedReport()
+{
+#if HID_DEFY_SPLIT_INTERFACES
+    // Each interface has its own endpoint, so both can have a report in flight within the same frame.
+    bool keyboardSuccess = SendNextReport(usb_hid, &reportQueue, false);
+    bool pointerSuccess = SendNextReport(usb_hid_pointer, &reportQueuePointer, true);
+
+    return keyboardSuccess && pointerSuccess;
+#else
+    return SendNextReport(usb_hid, &reportQueue, true);
+#endif
+}
+
+// The reportMutex must be held by the caller.
+bool HID_::SendNextReport(Adafruit_USBD_HID &hid, Spsc_fifo_buffer *queue, bool pointer)
+{
+    bool success = true;
+    LatestReport *latestReport;
+
+    // SendLastReport() runs on every loop, also while a report is in flight. Nothing can be sent then, and trying would
+    // overwrite the latency stamp of the report in flight.
+    if (!hid.ready() && !TinyUSBDevice.suspended())
+    {
+        return false;
+    }
+
+    latestReport = pointer ? latestReportDirtyGet() : nullptr;
+
+    // The stateful reports go first, so they never wait behind a keyboard backlog.
+    if (latestReport != nullptr)
+    {
+        success = hid.sendReport(latestReport->id, latestReport->current.data, latestReport->current.len);
+
+        if (success || TinyUSBDevice.suspended())
+        {
+            latestReport->current = latestReport->following;
+            latestReport->following.dirty = false;
+        }
+    }
+    else if (!queue->is_empty())
     {
-        struct
+        QueuedReport queuedReport;
+        queue->peek(&queuedReport);
+
+        // Set before sending, the report complete callback may fire before sendReport() returns. The endpoint is idle, so
+        // no other stamp is in flight and a failed send can take this one back.
+        if (queuedReport.keyTimed)
         {
-            NextReport nextReport;
-            uint8_t dataReport[256];
-        } nextReportWithData;
-        tu_fifo_peek_n(&tx_ff_hid, &nextReportWithData.nextReport, (uint16_t)(sizeof(nextReportWithData.nextReport)));
-        tu_fifo_peek_n(&tx_ff_hid, &nextReportWithData, (uint16_t)(sizeof(nextReportWithData.nextReport)) + nextReportWithData.nextReport.len);
+            keyReportInFlightTimeUs = queuedReport.keyTimeUs;
+            keyReportInFlight = true;
+        }
 
-        success = usb_hid.sendReport(nextReportWithData.nextReport.id, nextReportWithData.dataReport, nextReportWithData.nextReport.len);
+        success = hid.sendReport(queuedReport.id, queuedReport.data, queuedReport.len);
+        if (!success && queuedReport.keyTimed)
+        {
+            keyReportInFlight = false;
+        }
 
         if (success || TinyUSBDevice.suspended())
         {
-            tu_fifo_advance_read_pointer(&tx_ff_hid, (uint16_t)(sizeof(nextReportWithData.nextReport)) + nextReportWithData.nextReport.len);
+            queue->removeOne();
         }
     }
-    mutex_exit(&reportMutex);
+    else if (pointer && mouseAccumulator.pending)
+    {
+        // The accumulated mouse report goes after the queued reports, so it never overtakes them.
+        success = SendMouseReport(hid);
+    }
     return success;
 }
 
+// Invoked by TinyUSB when the report has been delivered to the host, chain the next queued one.
+extern "C" void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len)
+{
+    (void)instance;
+
+    // Every report on the interfaces carries its report ID in front.
+    HID().ReportComplete(len != 0 ? report[0] : HID_REPORTID_NONE);
+}
+
 HID_::HID_() : protocol(HID_REPORT_PROTOCOL), idle(0)
 {
     setReportData.reportId = 0;
@@ -171,7 +490,16 @@ int HID_::begin()
     usb_hid.setReportDescriptor(p_descriptor, descriptor_len);
     usb_hid.setBootProtocol(0);
     usb_hid.begin();
-    tu_fifo_config(&tx_ff_hid, tx_ff_buf_hid, TU_ARRAY_SIZE(tx_ff_buf_hid), 1, true);
+
+#if HID_DEFY_SPLIT_INTERFACES
+    /* Set the second interface, carrying the mouse, consumer and system control reports */
+    hid_report_descriptor_usb_pointer_get( &p_descriptor, &descriptor_len );
+
+    usb_hid_pointer.setPollInterval(1);
+    usb_hid_pointer.setReportDescriptor(p_descriptor, descriptor_len);
+    usb_hid_pointer.setBootProtocol(0);
+    usb_hid_pointer.begin();
+#endif
 
     return 0;
 }
@@ -33,9 +33,18 @@ THE SOFTWARE.
 
 #include "DescriptorPrimitives.h"
 #include "MultiReport/Keyboard.h"
+#include "Spsc_fifo_buffer.h"
 
 #define _USING_HID
 
+/*
+ * When enabled, the NKRO keyboard gets its own HID interface and endpoint, and the mouse, consumer and system control
+ * reports go through a second one. Key reports and pointer reports then no longer share the same 1 ms slot.
+ */
+#ifndef HID_DEFY_SPLIT_INTERFACES
+#define HID_DEFY_SPLIT_INTERFACES   0
+#endif
+
 // HID 'Driver'
 // ------------
 #define HID_GET_REPORT        0x01
@@ -99,6 +108,7 @@ class HID_ {
   int begin();
   int SendReport(uint8_t id, const void* data, int len);
   bool SendLastReport();
+  void ReportComplete(uint8_t id);
   void AppendDescriptor(HIDSubDescriptor* node);
 
   void hid_report_descriptor_get( const uint8_t ** pp_desc, uint32_t * p_desc_len );
@@ -110,10 +120,20 @@ class HID_ {
   uint8_t getShortName(char *name);
   int SendReport_(uint8_t id, const void* data, int len);
   Adafruit_USBD_HID usb_hid;
+#if HID_DEFY_SPLIT_INTERFACES
+  Adafruit_USBD_HID usb_hid_pointer;
+#endif
 private:
   char keyboarName[20] = "Defy RP2040";
 //  std::vector<uint8_t> descriptor;
 
+  void QueueReport(Spsc_fifo_buffer* queue, uint8_t id, const void* data, int len, bool keyTimed = false, uint32_t keyTimeUs = 0);
+  void MouseAccumulate(const void* data, int len);
+  bool EndpointReady();
+  bool SendQueuedReport();
+  bool SendNextReport(Adafruit_USBD_HID& hid, Spsc_fifo_buffer* queue, bool pointer);
+  bool SendMouseReport(Adafruit_USBD_HID& hid);
+
   uint8_t protocol;
   uint8_t idle;
   struct {
@@ -158,7 +178,7 @@ HID_COLLECTION_END                            \
 #define KEYBITS_PADDING
 #endif
 
-#define HID_DEFY_REPORT_DESCRIPTOR( usage_raw ) {                                                                                           \
+#define HID_DEFY_KEYBOARD_REPORT_DESCRIPTOR                                                                                                     \
     D_USAGE_PAGE, D_PAGE_GENERIC_DESKTOP, D_USAGE, D_USAGE_KEYBOARD, D_COLLECTION, D_APPLICATION, D_REPORT_ID, HID_REPORTID_NKRO_KEYBOARD,      \
     D_USAGE_PAGE, D_PAGE_KEYBOARD,                                                                                                              \
                                                                                                                                                 \
@@ -184,11 +204,16 @@ HID_COLLECTION_END                            \
     /* Padding to round up the report to byte boundary. */                                                                                      \
     KEYBITS_PADDING                                                                                                                             \
                                                                                                                                                 \
-    D_END_COLLECTION,                                                                                                                           \
-                                                                                                                                                \
+    D_END_COLLECTION,
+
+#define HID_DEFY_POINTER_REPORT_DESCRIPTOR                                                                                                      \
     TUD_HID_REPORT_DESC_MOUSE(HID_REPORT_ID(REPORT_ID_MOUSE)),                                                                                  \
     TUD_HID_REPORT_DESC_CONSUMER_DYGMA(HID_REPORT_ID(REPORT_ID_CONSUMER_CONTROL)),                                                              \
-    TUD_HID_REPORT_DESC_SYSTEM_CONTROL(HID_REPORT_ID(REPORT_ID_SYSTEM_CONTROL)),                                                                \
+    TUD_HID_REPORT_DESC_SYSTEM_CONTROL(HID_REPORT_ID(REPORT_ID_SYSTEM_CONTROL)),
+
+#define HID_DEFY_REPORT_DESCRIPTOR( usage_raw ) {                                                                                               \
+    HID_DEFY_KEYBOARD_REPORT_DESCRIPTOR                                                                                                         \
+    HID_DEFY_POINTER_REPORT_DESCRIPTOR                                                                                                          \
 }
 
 #endif // HID_h
@@ -42,6 +42,14 @@ extern result_t hal_ll_mcu_dma_trigger_channels_simultaneously( hal_mcu_dma_chan
 extern result_t hal_ll_mcu_dma_start_channels_simultaneously (hal_mcu_dma_channel_t* p_channel_1, const hal_mcu_dma_transfer_config_t *p_transfer_config_1,
                                                                                                                 hal_mcu_dma_channel_t* p_channel_2, const hal_mcu_dma_transfer_config_t *p_transfer_config_2);
 
+// Pre-compute the channel registers for the later transfer
+extern result_t hal_ll_mcu_dma_descriptor_prepare( hal_mcu_dma_channel_t * p_channel, const hal_mcu_dma_transfer_config_t * p_transfer_config,
+                                                   hal_mcu_dma_descriptor_t * p_descriptor );
+
+// Load two pre-computed descriptors and start both channels simultaneously
+extern result_t hal_ll_mcu_dma_descriptors_start_simultaneously( hal_mcu_dma_channel_t * p_channel_1, const hal_mcu_dma_descriptor_t * p_descriptor_1,
+                                                                 hal_mcu_dma_channel_t * p_channel_2, const hal_mcu_dma_descriptor_t * p_descriptor_2 );
+
 // Check if the DMA transfer is complete
 extern result_t hal_ll_mcu_dma_is_complete(hal_mcu_dma_channel_t* p_channel);
 
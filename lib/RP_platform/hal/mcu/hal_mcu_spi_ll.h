@@ -35,5 +35,7 @@ extern void hal_ll_mcu_spi_release( hal_mcu_spi_t * p_spi, hal_mcu_spi_lock_t lo
 extern result_t hal_ll_mcu_spi_data_transfer( hal_mcu_spi_t * p_spi, const hal_mcu_spi_transfer_conf_t * p_transfer_conf );
 
 extern bool_t hal_ll_mcu_spi_is_slave( hal_mcu_spi_t * p_spi );
+extern void hal_ll_mcu_spi_slave_stats_get( hal_mcu_spi_t * p_spi, hal_mcu_spi_slave_stats_t * p_stats );
+extern void hal_ll_mcu_spi_slave_stats_reset( hal_mcu_spi_t * p_spi );
 
 #endif /* __HAL_MCU_SPI_LL_H_ */
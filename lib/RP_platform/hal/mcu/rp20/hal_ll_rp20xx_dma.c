@@ -362,6 +362,19 @@ _EXIT:
     return result;
 }
 
+static INLINE void _channel_descriptor_load( hal_mcu_dma_channel_t * p_channel, const hal_mcu_dma_descriptor_t * p_descriptor )
+{
+    dma_channel_hw_t * p_dma_channel_hw = dma_channel_hw_addr( p_channel->channel_id );
+
+    // Save the size of transfer buffer for later use
+    p_channel->transfer_buffer_size = p_descriptor->transfer_count;
+
+    p_dma_channel_hw->read_addr = p_descriptor->read_address;
+    p_dma_channel_hw->write_addr = p_descriptor->write_address;
+    p_dma_channel_hw->transfer_count = p_descriptor->transfer_count;
+    p_dma_channel_hw->al1_ctrl = p_descriptor->ctrl;        // The alias does not trigger the channel
+}
+
 /******************** Low-Level hal functions ********************/
 
 result_t hal_ll_mcu_dma_channel_init( hal_mcu_dma_channel_t ** pp_channel ,  const hal_mcu_dma_channel_config_t * p_config )
@@ -449,6 +462,39 @@ _EXIT:
     return result;
 }
 
+result_t hal_ll_mcu_dma_descriptor_prepare( hal_mcu_dma_channel_t * p_channel, const hal_mcu_dma_transfer_config_t * p_transfer_config,
+                                            hal_mcu_dma_descriptor_t * p_descriptor )
+{
+    result_t result = RESULT_ERR;
+
+    if ( p_channel == NULL )
+    {
+        ASSERT_DYGMA( false, "DMA channel not initialized" );
+        return RESULT_ERR;
+    }
+
+    result = _channel_transfer_increment_set( p_channel, p_transfer_config );
+    EXIT_IF_ERR( result, "_channel_transfer_increment_set failed" );
+
+    p_descriptor->read_address = (uint32_t)p_transfer_config->read_address;
+    p_descriptor->write_address = (uint32_t)p_transfer_config->write_address;
+    p_descriptor->transfer_count = p_transfer_config->buffer_size;
+    p_descriptor->ctrl = channel_config_get_ctrl_value( &p_channel->sdk_dma_config );
+
+_EXIT:
+    return result;
+}
+
+result_t hal_ll_mcu_dma_descriptors_start_simultaneously( hal_mcu_dma_channel_t * p_channel_1, const hal_mcu_dma_descriptor_t * p_descriptor_1,
+                                                          hal_mcu_dma_channel_t * p_channel_2, const hal_mcu_dma_descriptor_t * p_descriptor_2 )
+{
+    _channel_descriptor_load( p_channel_1, p_descriptor_1 );
+    _channel_descriptor_load( p_channel_2, p_descriptor_2 );
+
+    dma_start_channel_mask( ( 1u << p_channel_1->channel_id ) | ( 1u << p_channel_2->channel_id ) );
+    return RESULT_OK;
+}
+
 result_t hal_ll_mcu_dma_is_complete( hal_mcu_dma_channel_t * p_channel )
 {
     if ( p_channel == NULL )
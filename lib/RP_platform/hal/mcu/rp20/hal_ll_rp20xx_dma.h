@@ -43,5 +43,17 @@ typedef enum {
     HAL_MCU_DMA_REQUEST_TYPE_PIO0_RX,
 } hal_mcu_dma_request_type_t;
 
+/*
+ * Pre-computed content of the DMA channel registers. Loading the descriptor is a plain copy into the channel, so
+ * the transfer can be armed from the time-critical code without evaluating the transfer configuration again.
+ */
+typedef struct
+{
+    uint32_t read_address;
+    uint32_t write_address;
+    uint32_t transfer_count;
+    uint32_t ctrl;
+} hal_mcu_dma_descriptor_t;
+
 
 #endif //_HAL_LL_RP20XX_DMA_H
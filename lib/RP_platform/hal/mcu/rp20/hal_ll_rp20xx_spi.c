@@ -24,17 +24,36 @@
 #include "hal_mcu_dma_ll.h"
 #include "hal_mcu_spi_ll.h"
 #include "hardware/gpio.h"
+#include "hardware/irq.h"
 #include "hardware/resets.h"
 #include "hardware/spi.h"
 #include "hardware/sync.h"
+#include "hardware/timer.h"
 
 
 //#if HAL_CFG_MCU_SERIES == HAL_MCU_SERIES_RP20
 
 #define DUMMY_OUT_VALUE     0xFF;
 
+/*
+ * Re-arm the slave on the Chip de-select event without resetting the whole SPI block. The FIFOs are drained instead and the line
+ * configuration is kept. The full reset is still used as a fallback whenever the Tx FIFO holds data the master did not clock out.
+ */
+#define HAL_LL_SPI_SLAVE_FAST_REARM     1
+
+/* Depth of the PL022 Tx FIFO, the CPU pre-fills up to this many bytes before the transfer is armed */
+#define SPI_TX_FIFO_DEPTH               8
+
+/*
+ * The transfer done processing of the superior layers runs from a user interrupt of this priority, which is below the GPIO
+ * interrupt. The Chip de-select of the other SPI port is then captured even while a finished transfer is being processed.
+ */
+#define SPI_SLAVE_DONE_IRQ_PRIORITY     PICO_LOWEST_IRQ_PRIORITY
+
 /* SDK Macros */
 #define SDK_SPI_TX_IS_FULL( p_spi )    ( (p_spi->p_spi_hw->sr & SPI_SSPSR_TNF_BITS) == 0 )     /* Transmit FIFO Not Full */
+#define SDK_SPI_TX_IS_EMPTY( p_spi )   ( (p_spi->p_spi_hw->sr & SPI_SSPSR_TFE_BITS) != 0 )     /* Transmit FIFO Empty */
+#define SDK_SPI_RX_IS_EMPTY( p_spi )   ( (p_spi->p_spi_hw->sr & SPI_SSPSR_RNE_BITS) == 0 )     /* Receive FIFO Not Empty */
 
 /* Peripheral definitions */
 typedef struct
@@ -93,6 +112,21 @@ typedef struct
     /* Flags */
     bool_t dummy_in_used;
     bool_t resend_request;
+    bool_t line_configured;     /* The line configuration survives until the next SPI block reset */
+
+    /* DMA descriptors prepared ahead of the transfer. Re-arming the transfer is then just loading them into the channels */
+    hal_mcu_dma_descriptor_t dma_desc_rx;
+    hal_mcu_dma_descriptor_t dma_desc_tx;
+    size_t tx_prefill_len;      /* The first output bytes written by the CPU, the Tx descriptor starts behind them */
+
+    /* The finished transfer handed over from the Chip de-select interrupt to the transfer done interrupt */
+    volatile bool_t transfer_done_pending;
+    hal_mcu_spi_transfer_result_t transfer_result_pending;
+
+    /* Re-arm timing */
+    bool_t rearm_pending;
+    uint32_t cs_deselect_time_us;
+    hal_mcu_spi_slave_stats_t stats;
 } slave_t;
 
 struct hal_mcu_spi
@@ -133,6 +167,9 @@ struct hal_mcu_spi
 static hal_mcu_spi_t * p_spi0 = NULL;
 static hal_mcu_spi_t * p_spi1 = NULL;
 
+/* User interrupt running the transfer done processing of all the SPI slaves */
+static int slave_done_irq = -1;
+
 /* SPI peripheral definitions */
 static const periph_def_t p_periph_def_array[] =
 {
@@ -173,6 +210,7 @@ static const bit_order_def_t p_bit_order_def_array[] =
 /* Prototypes */
 static result_t _dma_init( hal_mcu_spi_t * p_spi );
 static result_t _slave_init(hal_mcu_spi_t *p_spi, const hal_mcu_spi_conf_t *p_conf);
+static result_t _slave_transfer_prepare( hal_mcu_spi_t * p_spi );
 static result_t _slave_transfer( hal_mcu_spi_t* p_spi );
 static INLINE result_t _slave_transfer_enable( hal_mcu_spi_t * p_spi );
 static INLINE void _slave_spi_disable( hal_mcu_spi_t * p_spi );
@@ -319,7 +357,35 @@ static INLINE void _slave_spi_reset( hal_mcu_spi_t * p_spi )
 {
     reset_block( p_spi->p_periph_def->pico_reset_bits );
     unreset_block( p_spi->p_periph_def->pico_reset_bits );
+
+    /* The reset wipes out the line configuration as well */
+    p_spi->slave.line_configured = false;
+}
+
+#if HAL_LL_SPI_SLAVE_FAST_REARM
+static INLINE bool_t _slave_spi_fifos_flush( hal_mcu_spi_t * p_spi )
+{
+    /*
+     * The PL022 provides no way to flush the Tx FIFO other than the block reset. If the master finished the transfer before all
+     * the prepared data has been clocked out, the leftover would be sent at the beginning of the next transfer.
+     */
+    if( SDK_SPI_TX_IS_EMPTY( p_spi ) == false )
+    {
+        return false;
+    }
+
+    /* Drop the data which has not been picked by the Rx DMA */
+    while( SDK_SPI_RX_IS_EMPTY( p_spi ) == false )
+    {
+        (void)p_spi->p_spi_hw->dr;
+    }
+
+    /* Clear the receive overrun flag which might have been raised by the master clocking more data than expected */
+    p_spi->p_spi_hw->icr = SPI_SSPICR_RORIC_BITS;
+
+    return true;
 }
+#endif /* HAL_LL_SPI_SLAVE_FAST_REARM */
 
 static INLINE bool_t _slave_spi_is_running( hal_mcu_spi_t * p_spi )
 {
@@ -386,8 +452,18 @@ static INLINE void _slave_spi_disable( hal_mcu_spi_t * p_spi )
     /* Disable the DMA */
     _slave_spi_dma_disable( p_spi );
 
+#if HAL_LL_SPI_SLAVE_FAST_REARM
+    if( _slave_spi_fifos_flush( p_spi ) == true )
+    {
+        p_spi->slave.stats.rearm_fast_count++;
+        return;
+    }
+#endif /* HAL_LL_SPI_SLAVE_FAST_REARM */
+
     /* We completely de-initialize the SPI to wipe out all data which might be still sitting in the SPI internal buffers */
     _slave_spi_reset ( p_spi );
+
+    p_spi->slave.stats.rearm_reset_count++;
 }
 
 static INLINE hal_mcu_spi_t * _slave_cs_instance_get( uint gpio )
@@ -431,7 +507,7 @@ static INLINE bool_t _slave_transfer_result_get( hal_mcu_spi_t * p_spi, hal_mcu_
 
     /* Get the final count of data that has been transferred during the transfer session */
     p_transfer_result->data_in_len = hal_ll_mcu_dma_get_transfer_count( p_spi->dma_rx.p_dma );
-    p_transfer_result->data_out_len = hal_ll_mcu_dma_get_transfer_count( p_spi->dma_tx.p_dma );
+    p_transfer_result->data_out_len = p_spi->slave.tx_prefill_len + hal_ll_mcu_dma_get_transfer_count( p_spi->dma_tx.p_dma );
 
     /* NOTE: The DMA Tx number is lowered when the data is transferred to the SPI Tx buffer. However, it might not be sent out to the SPI
      *       master yet. Hence the data_out_len is never going to be 100% sure.
@@ -485,6 +561,10 @@ static INLINE void _slave_cs_deselected_process( hal_mcu_spi_t *p_spi )
         return;
     }
 
+    /* The master may start the next transfer no sooner than the SPI is enabled again. Measure how long it takes */
+    p_spi->slave.cs_deselect_time_us = time_us_32();
+    p_spi->slave.rearm_pending = true;
+
     /* Disable the SPI peripheral */
     _slave_spi_disable( p_spi );
 
@@ -495,8 +575,7 @@ static INLINE void _slave_cs_deselected_process( hal_mcu_spi_t *p_spi )
     hal_mcu_dma_stop( p_spi->dma_tx.p_dma );
     hal_mcu_dma_stop( p_spi->dma_rx.p_dma );
 
-    /* The transfer is done */
-    p_spi->slave.dummy_in_used = false;
+    /* The transfer is done. The dummy_in_used flag stays as it belongs to the prepared DMA descriptors which might be re-armed below */
     p_spi->busy = false;
 
     /* Check whether there was a valid transfer actually. */
@@ -511,17 +590,61 @@ static INLINE void _slave_cs_deselected_process( hal_mcu_spi_t *p_spi )
     }
     else
     {
-        /* Transfer is valid - Let the superior layers know that the transfer is finished */
-        _slave_transfer_done_handler( p_spi, &transfer_result );
+        /*
+         * Transfer is valid - Let the superior layers know that the transfer is finished. They decide the next transfer from its
+         * result, so the next descriptors are prepared from the transfer done interrupt and not here.
+         */
+        ASSERT_DYGMA( p_spi->slave.transfer_done_pending == false, "SPI Slave - the previous transfer has not been processed yet" );
+
+        p_spi->slave.transfer_result_pending = transfer_result;
+        p_spi->slave.transfer_done_pending = true;
+        irq_set_pending( slave_done_irq );
     }
 
     UNUSED( result );
 }
 
+static void _slave_done_irq_handler( void )
+{
+    hal_mcu_spi_transfer_result_t transfer_result;
+    uint32_t irq_start_us;
+    uint32_t irq_time_us;
+
+    for( size_t i = 0; i < ( sizeof( p_periph_def_array ) / sizeof( p_periph_def_array[0] ) ); i++ )
+    {
+        hal_mcu_spi_t * p_spi = *p_periph_def_array[i].pp_periph;
+
+        if( p_spi == NULL || p_spi->role != HAL_MCU_SPI_ROLE_SLAVE || p_spi->slave.transfer_done_pending == false )
+        {
+            continue;
+        }
+
+        irq_start_us = time_us_32();
+
+        /*
+         * Take the result over before processing it. The processing arms the next transfer, and its Chip de-select may come
+         * before the processing returns.
+         */
+        transfer_result = p_spi->slave.transfer_result_pending;
+        p_spi->slave.transfer_done_pending = false;
+
+        _slave_transfer_done_handler( p_spi, &transfer_result );
+
+        /* The transfer done processing of the superior layers including the start of the next transfer */
+        irq_time_us = time_us_32() - irq_start_us;
+        if( irq_time_us > p_spi->slave.stats.done_time_max_us )
+        {
+            p_spi->slave.stats.done_time_max_us = irq_time_us;
+        }
+    }
+}
+
 static void _slave_cs_irq_handler( uint gpio, uint32_t event_mask )
 {
     /* Get the SPI instance from the peripheral definition */
     hal_mcu_spi_t * p_spi = _slave_cs_instance_get( gpio );
+    uint32_t irq_start_us = time_us_32();
+    uint32_t irq_time_us;
 
     if ( event_mask & GPIO_IRQ_EDGE_FALL )
     {
@@ -532,6 +655,13 @@ static void _slave_cs_irq_handler( uint gpio, uint32_t event_mask )
     {
         _slave_cs_deselected_process( p_spi );
     }
+
+    /* The Chip de-select handling only, the superior layers process the transfer from the transfer done interrupt */
+    irq_time_us = time_us_32() - irq_start_us;
+    if( irq_time_us > p_spi->slave.stats.irq_time_max_us )
+    {
+        p_spi->slave.stats.irq_time_max_us = irq_time_us;
+    }
 }
 
 static result_t _slave_init(hal_mcu_spi_t *p_spi, const hal_mcu_spi_conf_t *p_conf)
@@ -551,6 +681,15 @@ static result_t _slave_init(hal_mcu_spi_t *p_spi, const hal_mcu_spi_conf_t *p_co
     
     gpio_pull_up(p_conf->slave.pin_cs);
 
+    /* The transfer done interrupt is shared by all the SPI slaves */
+    if( slave_done_irq < 0 )
+    {
+        slave_done_irq = user_irq_claim_unused( true );
+        irq_set_exclusive_handler( slave_done_irq, _slave_done_irq_handler );
+        irq_set_priority( slave_done_irq, SPI_SLAVE_DONE_IRQ_PRIORITY );
+        irq_set_enabled( slave_done_irq, true );
+    }
+
     /* Enable the CS gpio interrupt. We are interested only in the rising edge which is signalling the transfer has been finished */
     gpio_set_irq_enabled_with_callback(p_conf->slave.pin_cs, GPIO_IRQ_EDGE_RISE , true, _slave_cs_irq_handler );
 
@@ -561,6 +700,14 @@ static result_t _slave_init(hal_mcu_spi_t *p_spi, const hal_mcu_spi_conf_t *p_co
     /* Flags */
     p_spi->slave.dummy_in_used = false;
     p_spi->slave.resend_request = false;
+    p_spi->slave.line_configured = false;
+    p_spi->slave.tx_prefill_len = 0;
+    p_spi->slave.transfer_done_pending = false;
+
+    /* Re-arm timing */
+    p_spi->slave.rearm_pending = false;
+    p_spi->slave.cs_deselect_time_us = 0;
+    memset( &p_spi->slave.stats, 0x00, sizeof( p_spi->slave.stats ) );
 
     /* Perform initial SPI reset to set it into default state */
     _slave_spi_reset ( p_spi );
@@ -570,6 +717,19 @@ static result_t _slave_init(hal_mcu_spi_t *p_spi, const hal_mcu_spi_conf_t *p_co
     return RESULT_OK;
 }
 
+static INLINE void _slave_rearm_time_update( hal_mcu_spi_t * p_spi )
+{
+    uint32_t rearm_time_us = time_us_32() - p_spi->slave.cs_deselect_time_us;
+
+    p_spi->slave.rearm_pending = false;
+
+    p_spi->slave.stats.rearm_time_last_us = rearm_time_us;
+    if( rearm_time_us > p_spi->slave.stats.rearm_time_max_us )
+    {
+        p_spi->slave.stats.rearm_time_max_us = rearm_time_us;
+    }
+}
+
 static INLINE result_t _slave_transfer_enable( hal_mcu_spi_t * p_spi )
 {
     result_t result = RESULT_ERR;
@@ -579,12 +739,17 @@ static INLINE result_t _slave_transfer_enable( hal_mcu_spi_t * p_spi )
         return RESULT_BUSY;
     }
 
-    /* Configure the SPI line */
-    result = _spi_line_configure( p_spi, &p_spi->slave.line );
-    EXIT_IF_ERR( result, "_spi_line_configure failed" );
+    if( p_spi->slave.line_configured == false )
+    {
+        /* Configure the SPI line */
+        result = _spi_line_configure( p_spi, &p_spi->slave.line );
+        EXIT_IF_ERR( result, "_spi_line_configure failed" );
 
-    /* Set the SPI to slave mode. */
-    spi_set_slave( p_spi->p_periph_def->p_pico_spi_inst, true );
+        /* Set the SPI to slave mode. */
+        spi_set_slave( p_spi->p_periph_def->p_pico_spi_inst, true );
+
+        p_spi->slave.line_configured = true;
+    }
 
     /* Enable the DMA */
     _slave_spi_dma_enable( p_spi );
@@ -598,17 +763,19 @@ static INLINE result_t _slave_transfer_enable( hal_mcu_spi_t * p_spi )
         /* Disable the SPI peripheral which will reset it to its initial state. */
         _slave_spi_disable( p_spi );
     }
+    else if( p_spi->slave.rearm_pending == true )
+    {
+        _slave_rearm_time_update( p_spi );
+    }
 
 _EXIT:
     return result;
 }
 
-static result_t _slave_transfer( hal_mcu_spi_t* p_spi )
+static result_t _slave_transfer_prepare( hal_mcu_spi_t * p_spi )
 {
     result_t result = RESULT_ERR;
 
-    ASSERT_DYGMA( p_spi->busy == false, "The SPI slave must not be busy before starting the new SPI transfer." );
-
     hal_mcu_dma_transfer_config_t dma_transfer_config_rx;
     hal_mcu_dma_transfer_config_t dma_transfer_config_tx;
 
@@ -638,14 +805,19 @@ static result_t _slave_transfer( hal_mcu_spi_t* p_spi )
         p_spi->slave.dummy_in_used = true;
     }
 
-    /* Set the TX DMA transfer configuration */
-    dma_transfer_config_tx.buffer_size = p_spi->data_out_len;
+    /*
+     * Set the TX DMA transfer configuration. The CPU pre-fills the Tx FIFO with the first bytes when the transfer is armed, so the
+     * first byte is in place no matter how soon the master starts clocking. The DMA sends the rest.
+     */
+    p_spi->slave.tx_prefill_len = ( p_spi->data_out_len < SPI_TX_FIFO_DEPTH ) ? p_spi->data_out_len : SPI_TX_FIFO_DEPTH;
+
+    dma_transfer_config_tx.buffer_size = p_spi->data_out_len - p_spi->slave.tx_prefill_len;
     dma_transfer_config_tx.write_address = (void *)&p_spi->p_spi_hw->dr;
     dma_transfer_config_tx.write_increment_mode = HAL_MCU_DMA_INC_MODE_DISABLED;
 
     if( p_spi->data_out_len != 0 )
     {
-            dma_transfer_config_tx.read_address = p_spi->p_data_out;
+            dma_transfer_config_tx.read_address = p_spi->p_data_out + p_spi->slave.tx_prefill_len;
             dma_transfer_config_tx.read_increment_mode = HAL_MCU_DMA_INC_MODE_ENABLED;
     }
     else
@@ -655,21 +827,34 @@ static result_t _slave_transfer( hal_mcu_spi_t* p_spi )
             dma_transfer_config_tx.read_increment_mode = HAL_MCU_DMA_INC_MODE_DISABLED;
     }
 
-    /* Pre-fill the SPI Tx fifo */
-    while( dma_transfer_config_tx.buffer_size > 0 && SDK_SPI_TX_IS_FULL( p_spi ) == false )
-    {
-        /* Prepare the first byte in the output buffer */
-        p_spi->p_spi_hw->dr = (uint32_t)*( (uint8_t *)dma_transfer_config_tx.read_address );
+    /* Compute the DMA descriptors now, so the transfer (and any of its re-arms from the Chip de-select interrupt) only loads them */
+    result = hal_ll_mcu_dma_descriptor_prepare( p_spi->dma_rx.p_dma, &dma_transfer_config_rx, &p_spi->slave.dma_desc_rx );
+    EXIT_IF_ERR( result, "RX hal_ll_mcu_dma_descriptor_prepare failed" );
+
+    result = hal_ll_mcu_dma_descriptor_prepare( p_spi->dma_tx.p_dma, &dma_transfer_config_tx, &p_spi->slave.dma_desc_tx );
+    EXIT_IF_ERR( result, "TX hal_ll_mcu_dma_descriptor_prepare failed" );
+
+_EXIT:
+    return result;
+}
+
+static result_t _slave_transfer( hal_mcu_spi_t* p_spi )
+{
+    result_t result = RESULT_ERR;
 
-        dma_transfer_config_tx.read_address++;
-        dma_transfer_config_tx.buffer_size--;
+    ASSERT_DYGMA( p_spi->busy == false, "The SPI slave must not be busy before starting the new SPI transfer." );
+
+    /* Pre-fill the SPI Tx fifo. It is empty here, the previous transfer left it either drained or reset */
+    for( size_t i = 0; i < p_spi->slave.tx_prefill_len; i++ )
+    {
+        p_spi->p_spi_hw->dr = (uint32_t)p_spi->p_data_out[i];
     }
 
-    /* Prepare both DMA channels simultaneously */
+    /* Start both DMA channels simultaneously */
     p_spi->busy = true;
 
-    result = hal_ll_mcu_dma_start_channels_simultaneously( p_spi->dma_tx.p_dma, &dma_transfer_config_tx, p_spi->dma_rx.p_dma , &dma_transfer_config_rx );
-    ASSERT_DYGMA( result == RESULT_OK, "hal_mcu_dma_start_channels_simultaneously failed" );
+    result = hal_ll_mcu_dma_descriptors_start_simultaneously( p_spi->dma_tx.p_dma, &p_spi->slave.dma_desc_tx, p_spi->dma_rx.p_dma, &p_spi->slave.dma_desc_rx );
+    ASSERT_DYGMA( result == RESULT_OK, "hal_ll_mcu_dma_descriptors_start_simultaneously failed" );
     EXIT_IF_NOK( result );
 
     /* Enable the SPI */
@@ -732,6 +917,9 @@ static result_t _slave_transfer_start(hal_mcu_spi_t* p_spi,  const hal_mcu_spi_t
     p_spi->data_in_len = p_transfer_conf->data_in_len;
     p_spi->data_out_len = p_transfer_conf->data_out_len;
 
+    result = _slave_transfer_prepare( p_spi );
+    EXIT_IF_ERR( result, "_slave_transfer_prepare failed" );
+
     result = _slave_transfer( p_spi );
     EXIT_IF_ERR( result, "_slave_transfer failed" );
 
@@ -816,6 +1004,20 @@ void hal_ll_mcu_spi_release( hal_mcu_spi_t * p_spi, hal_mcu_spi_lock_t lock )
     p_spi->reserved = false;
 }
 
+void hal_ll_mcu_spi_slave_stats_get( hal_mcu_spi_t * p_spi, hal_mcu_spi_slave_stats_t * p_stats )
+{
+    ASSERT_DYGMA( p_spi->role == HAL_MCU_SPI_ROLE_SLAVE, "The slave statistics are available for the SPI slave only." );
+
+    *p_stats = p_spi->slave.stats;
+}
+
+void hal_ll_mcu_spi_slave_stats_reset( hal_mcu_spi_t * p_spi )
+{
+    ASSERT_DYGMA( p_spi->role == HAL_MCU_SPI_ROLE_SLAVE, "The slave statistics are available for the SPI slave only." );
+
+    memset( &p_spi->slave.stats, 0x00, sizeof( p_spi->slave.stats ) );
+}
+
 result_t hal_ll_mcu_spi_data_transfer( hal_mcu_spi_t * p_spi, const hal_mcu_spi_transfer_conf_t * p_transfer_conf )
 {
     result_t result = RESULT_ERR;
@@ -68,3 +68,12 @@ bool_t hal_mcu_spi_is_slave( hal_mcu_spi_t * p_spi )
     return hal_ll_mcu_spi_is_slave( p_spi );
 }
 
+void hal_mcu_spi_slave_stats_get( hal_mcu_spi_t * p_spi, hal_mcu_spi_slave_stats_t * p_stats )
+{
+    hal_ll_mcu_spi_slave_stats_get( p_spi, p_stats );
+}
+
+void hal_mcu_spi_slave_stats_reset( hal_mcu_spi_t * p_spi )
+{
+    hal_ll_mcu_spi_slave_stats_reset( p_spi );
+}
@@ -120,6 +120,22 @@ typedef struct
     hal_mcu_spi_transfer_conf_slave_handlers_t slave_handlers;
 } hal_mcu_spi_transfer_conf_t;
 
+typedef struct
+{
+    uint32_t rearm_fast_count;      /* Transfers finished by draining the FIFOs */
+    uint32_t rearm_reset_count;     /* Transfers finished by the full SPI block reset */
+
+    /* Time from the Chip de-select until the slave is able to accept the next transfer */
+    uint32_t rearm_time_last_us;
+    uint32_t rearm_time_max_us;
+
+    /* The longest Chip select interrupt */
+    uint32_t irq_time_max_us;
+
+    /* The longest transfer done interrupt, the processing of the superior layers including the start of the next transfer */
+    uint32_t done_time_max_us;
+} hal_mcu_spi_slave_stats_t;
+
 /* Lock */
 typedef uint32_t hal_mcu_spi_lock_t;
 
@@ -132,6 +148,8 @@ extern void hal_mcu_spi_release( hal_mcu_spi_t * p_spi, hal_mcu_spi_lock_t lock
 extern result_t hal_mcu_spi_data_transfer( hal_mcu_spi_t * p_spi, const hal_mcu_spi_transfer_conf_t * p_transfer_conf );
 
 extern bool_t hal_mcu_spi_is_slave( hal_mcu_spi_t * p_spi );
+extern void hal_mcu_spi_slave_stats_get( hal_mcu_spi_t * p_spi, hal_mcu_spi_slave_stats_t * p_stats );
+extern void hal_mcu_spi_slave_stats_reset( hal_mcu_spi_t * p_spi );
 
 #ifdef __cplusplus
 }
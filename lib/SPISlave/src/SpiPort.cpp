@@ -21,7 +21,7 @@
 
 #include "SpiPort.h"
 
-#include "Fifo_buffer.h"
+#include "Fifo.h"
 
 
 // SPI0
@@ -30,7 +30,8 @@ Spi_slave spi0_slave(0,                /* Chip SPI port used */
                      PIN_MISO0,        /* MISO0 */
                      PIN_MOSI0,        /* MOSI0 */
                      PIN_CLK0,         /* Clock0 */
-                     PIN_CS0        /* Chip Select 0 */
+                     PIN_CS0,       /* Chip Select 0 */
+                     PIN_INT0       /* Data ready INT 0 */
                     ); 
 #endif
 
@@ -40,7 +41,8 @@ Spi_slave spi1_slave(1,                /* Chip SPI port used */
                      PIN_MISO1,        /* MISO1 */
                      PIN_MOSI1,        /* MOSI1 */
                      PIN_CLK1,         /* Clock1 */
-                     PIN_CS1           /* Chip Select 1 */
+                     PIN_CS1,          /* Chip Select 1 */
+                     PIN_INT1          /* Data ready INT 1 */
                      );
 #endif
 
@@ -97,26 +99,22 @@ bool SpiPort::is_connected() {
 bool SpiPort::sendPacket(Packet &packet) {
     if (spi_slave == nullptr) return false;
 
-    spi_slave->tx_fifo->put(&packet);
-
-    return true;
+    // Fails while the Tx fifo is full, the caller keeps the packet and sends it again later.
+    return spi_slave->tx_fifo->put(&packet);
 }
 
 void SpiPort::clearSend() {
     if (spi_slave == nullptr) return ;
 
-    while (!spi_slave->tx_fifo->is_empty()){
-        spi_slave->tx_fifo->removeOne();
-    }
+    // The Tx fifo is consumed by the Spi_slave, so it is only asked to drop the packets queued so far.
+    spi_slave->tx_fifo->clear_request();
 
 }
 
 void SpiPort::clearRead() {
     if (spi_slave == nullptr) return ;
 
-    while (!spi_slave->rx_fifo->is_empty()){
-        spi_slave->rx_fifo->removeOne();
-    }
+    spi_slave->rx_fifo->clear();
 
 }
 
@@ -130,6 +128,30 @@ bool SpiPort::readPacket(Packet &packet) {
     return true;
 }
 
+uint16_t SpiPort::readPackets(Packet *packets, uint16_t count) {
+    if (spi_slave == nullptr) return 0;
+
+    return spi_slave->rx_fifo->get_n(packets, count);
+}
+
+uint16_t SpiPort::peekPackets(const Packet *&packets) {
+    Packet *p_packets;
+    uint16_t count;
+
+    if (spi_slave == nullptr) return 0;
+
+    count = spi_slave->rx_fifo->peek_span(&p_packets);
+    packets = p_packets;
+
+    return count;
+}
+
+void SpiPort::discardPackets(uint16_t count) {
+    if (spi_slave == nullptr) return;
+
+    spi_slave->rx_fifo->remove_n(count);
+}
+
 bool SpiPort::peekPacket(Packet &packet) {
     if (spi_slave == nullptr) return false;
 
@@ -139,3 +161,18 @@ bool SpiPort::peekPacket(Packet &packet) {
 
     return true;
 }
+
+void SpiPort::getStats(spi_slave_stats_t &stats) {
+    if (spi_slave == nullptr) {
+        memset(&stats, 0, sizeof(stats));
+        return;
+    }
+
+    spi_slave->stats_get(&stats);
+}
+
+void SpiPort::resetStats() {
+    if (spi_slave == nullptr) return;
+
+    spi_slave->stats_reset();
+}
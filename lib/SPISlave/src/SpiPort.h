@@ -39,6 +39,7 @@ using namespace Communications_protocol;
 #define PIN_MOSI0         20
 #define PIN_CLK0          18
 #define PIN_CS0           21
+#define PIN_INT0          SPI_SLAVE_PIN_INT_NONE    // Data-ready INT signal, set the GPIO once it is wired to the side
 
 
 // SPI1
@@ -47,6 +48,7 @@ using namespace Communications_protocol;
 #define PIN_MOSI1   8
 #define PIN_CLK1    14
 #define PIN_CS1     9
+#define PIN_INT1    SPI_SLAVE_PIN_INT_NONE          // Data-ready INT signal, set the GPIO once it is wired to the side
 
 // SPI2
 #if 0
@@ -75,11 +77,20 @@ class SpiPort
         bool readPacket(Packet &packet);    /* Function will provide current packet and discard it from the queue*/
         bool peekPacket(Packet &packet);    /* Function will provide current packet but keeps it in the queue */
 
+        uint16_t readPackets(Packet *packets, uint16_t count);  /* Reads up to count packets, returns the number of packets read */
+
+        /* Provides the packets in the queue storage without copying them, returns their count. They stay valid until discarded */
+        uint16_t peekPackets(const Packet *&packets);
+        void discardPackets(uint16_t count);
+
         bool sendPacket(Packet &packet);
 
         void clearSend();
         void clearRead();
 
+        void getStats(spi_slave_stats_t &stats);
+        void resetStats();
+
 
        private:
         uint8_t spi_port_used;
@@ -50,8 +50,20 @@
 #include "CRC_wrapper.h"
 #include "common.h"
 
-#define SPILS_MESSAGE_SIZE_MAX          (SPI_SLAVE_PACKET_SIZE * 4)
+/* The rest of the link configuration, see Spi_slave.h */
+#ifndef SPILS_DATA_PIGGYBACK_ENABLE
+#define SPILS_DATA_PIGGYBACK_ENABLE     false   /* Keep disabled until the keyscanner parses the data appended to the result messages */
+#endif
 #define SPILS_DISCONNECT_TIMEOUT_MS     1000
+#ifndef SPILS_TRANSFER_DONE_DEFERRED
+#define SPILS_TRANSFER_DONE_DEFERRED    false   /* Process the finished transfers from run() instead of the transfer done interrupt */
+#endif
+
+#if SPI_SLAVE_TX_BATCH_SUPPORT
+    #define SPI_SLAVE_TX_PACKETS_MAX    SPI_SLAVE_MESSAGE_PACKETS
+#else
+    #define SPI_SLAVE_TX_PACKETS_MAX    1
+#endif
 
 typedef struct
 {
@@ -66,6 +78,11 @@ static const spi_port_def_t p_spi_port_def_array[] =
 };
 #define get_spi_port_def( def, id ) _get_def( def, p_spi_port_def_array, spi_port_def_t, spi_port, id )
 
+/* The default does nothing, the application overrides it to timestamp the key packets */
+__attribute__((weak)) void spi_slave_key_packet_received( void )
+{
+}
+
 void Spi_slave::spils_event_handler(void *p_instance, spils_event_type_t event_type) 
 {
     Spi_slave * p_slave = ( Spi_slave* )p_instance;
@@ -106,12 +123,13 @@ void Spi_slave::spils_event_handler(void *p_instance, spils_event_type_t event_t
 
 }
 
-Spi_slave::Spi_slave(uint8_t _spi_port, uint32_t _miso_pin, uint32_t _mosi_pin, uint32_t _sck_pin, uint32_t _cs_pin)
+Spi_slave::Spi_slave(uint8_t _spi_port, uint32_t _miso_pin, uint32_t _mosi_pin, uint32_t _sck_pin, uint32_t _cs_pin, uint32_t _int_pin)
   : spi_port(_spi_port),
     miso_pin(_miso_pin),
     mosi_pin(_mosi_pin),
     sck_pin(_sck_pin),
-    cs_pin(_cs_pin) {
+    cs_pin(_cs_pin),
+    int_pin(_int_pin) {
 
   rx_fifo = &spi_rx_fifo;
   tx_fifo = &spi_tx_fifo;
@@ -142,15 +160,20 @@ void Spi_slave::init( void )
     config.spi.line.bit_order = HAL_MCU_SPI_BIT_ORDER_MSB_FIRST;
 
     /* GPIO */
-    config.pin_int_enable = false;
-    //config.pin_int = ;
+    config.pin_int_enable = ( int_pin != SPI_SLAVE_PIN_INT_NONE );
+    config.pin_int = (hal_mcu_gpio_pin_t)int_pin;
 
     /* Cache */
     config.message_size_max = SPILS_MESSAGE_SIZE_MAX;
+    config.buffers_in_count = SPILS_BUFFERS_IN_COUNT;
+    config.data_piggyback_enable = SPILS_DATA_PIGGYBACK_ENABLE;
 
     /* Connection */
     config.disconnect_timeout_ms = SPILS_DISCONNECT_TIMEOUT_MS;
 
+    /* Transfer processing */
+    config.transfer_done_deferred = SPILS_TRANSFER_DONE_DEFERRED;
+
     /* Event handlers */
     config.p_instance = this;
     config.event_handler = spils_event_handler;
@@ -176,6 +199,18 @@ bool_t Spi_slave::is_connected(void)
     return is_connected_;
 }
 
+void Spi_slave::stats_get(spi_slave_stats_t *p_stats)
+{
+    *p_stats = stats;
+    spils_stats_get( p_spils, &p_stats->link );
+}
+
+void Spi_slave::stats_reset(void)
+{
+    memset( &stats, 0x00, sizeof( stats ) );
+    spils_stats_reset( p_spils );
+}
+
 void Spi_slave::packet_in_process( Communications_protocol::Packet * p_spi_packet )
 {
     uint8_t spi_packet_crc;
@@ -183,9 +218,27 @@ void Spi_slave::packet_in_process( Communications_protocol::Packet * p_spi_packe
     /* Parse the packet */
     spi_packet_crc = p_spi_packet->header.crc;
     p_spi_packet->header.crc = 0;
-    if ( crc8( p_spi_packet->buf, sizeof(Communications_protocol::Header) + p_spi_packet->header.size ) == spi_packet_crc )
+    if ( crc8( p_spi_packet->buf, sizeof(Communications_protocol::Header) + p_spi_packet->header.size ) != spi_packet_crc )
+    {
+        stats.packets_crc_err_count++;
+        return;
+    }
+
+    if ( spi_rx_fifo.put( p_spi_packet ) == false )  // Put the new spi_packet in the Rx FIFO.
     {
-        spi_rx_fifo.put( p_spi_packet );  // Put the new spi_packet in the Rx FIFO.
+        stats.packets_in_dropped_count++;
+        return;
+    }
+
+    stats.packets_in_count++;
+    if ( p_spi_packet->header.command == Communications_protocol::HAS_KEYS )
+    {
+        spi_slave_key_packet_received();
+    }
+
+    if ( spi_rx_fifo.get_num_items() > stats.rx_fifo_depth_max )
+    {
+        stats.rx_fifo_depth_max = spi_rx_fifo.get_num_items();
     }
 }
 
@@ -195,31 +248,41 @@ void Spi_slave::data_in_process( void )
 
     Communications_protocol::Packet * p_spi_packet_in;
 
-    uint8_t p_data[SPILS_MESSAGE_SIZE_MAX];
-    uint16_t data_pos = 0;
-    uint16_t data_in_len;
+    uint8_t * p_data;
+    uint16_t data_pos;
+    uint16_t data_in_len = 0;
 
     //This will be true if the event handler (spils_event_handler) has been called with SPILS_EVENT_TYPE_DATA_IN_READY event.
-    if( spils_data_in_received == false )
+    while( spils_data_in_received == true )
     {
-        return;
-    }
-
-    memset( p_data, 0x00, sizeof( p_data ) );
+        /* Borrow the received message directly from the link input buffer, the packets are checked and dispatched in place */
+        result = spils_data_borrow( p_spils, &p_data, &data_in_len );
+        EXIT_IF_NOK( result );
+        ASSERT_DYGMA( (data_in_len % sizeof(Communications_protocol::Packet) ) == 0, "Invalid size of the SPI slave packet received" );
+
+        /* The message stays in the link input ring until all its packets fit in the rx_fifo, the link answers busy meanwhile */
+        if( data_in_len / sizeof(Communications_protocol::Packet) > SPI_SLAVE_RX_FIFO_PACKETS - spi_rx_fifo.get_num_items() )
+        {
+            break;
+        }
 
-    result = spils_data_read( p_spils, p_data, &data_in_len );
-    ASSERT_DYGMA( (data_in_len % sizeof(Communications_protocol::Packet) ) == 0, "Invalid size of the SPI slave packet received" );
-    EXIT_IF_NOK( result );
+        data_pos = 0;
+        while( data_in_len >= sizeof(Communications_protocol::Packet) )
+        {
+            p_spi_packet_in = ( Communications_protocol::Packet *)&p_data[data_pos];
+            packet_in_process( p_spi_packet_in );
 
-    spils_data_in_received = spils_data_read_available( p_spils );
+            data_pos += sizeof(Communications_protocol::Packet);
+            data_in_len -= sizeof(Communications_protocol::Packet);
+        }
 
-    while( data_in_len >= sizeof(Communications_protocol::Packet) )
-    {
-        p_spi_packet_in = ( Communications_protocol::Packet *)&p_data[data_pos];
-        packet_in_process( p_spi_packet_in );
+        if( p_data != NULL )
+        {
+            result = spils_data_release( p_spils );
+            EXIT_IF_NOK( result );
+        }
 
-        data_pos += sizeof(Communications_protocol::Packet);
-        data_in_len -= sizeof(Communications_protocol::Packet);
+        spils_data_in_received = spils_data_read_available( p_spils );
     }
 
 _EXIT:
@@ -229,8 +292,13 @@ _EXIT:
 void Spi_slave::data_out_process( void )
 {
     result_t result = RESULT_ERR;
-    Communications_protocol::Packet spi_packet;
-    size_t data_out_len;
+    Communications_protocol::Packet * p_spi_packets;
+    Communications_protocol::Packet * p_spi_packet;
+    size_t spi_packets_count;
+    size_t tx_fifo_items;
+
+    /* Drop the packets SpiPort::clearSend() asked for. The Tx fifo can only be cleared from here, on its consumer side */
+    spi_tx_fifo.clear_apply( );
 
     /* Check if the send process is still running or the TX fifo is empty */
     if( spils_data_out_sending == true || spi_tx_fifo.is_empty( ) == true )
@@ -238,19 +306,42 @@ void Spi_slave::data_out_process( void )
         return;
     }
 
-    /* Get packet from the Tx fifo */
-    data_out_len = spi_tx_fifo.get( &spi_packet );
-    ASSERT_DYGMA( data_out_len == sizeof( spi_packet ), "Failure: Empty Packet received from FIFO" );
+    /* The Tx fifo is filled by the superior layers, so its depth is sampled before it gets drained */
+    tx_fifo_items = spi_tx_fifo.get_num_items();
+    if ( tx_fifo_items > stats.tx_fifo_depth_max )
+    {
+        stats.tx_fifo_depth_max = tx_fifo_items;
+    }
 
-    spi_packet.header.has_more_packets = ( spi_tx_fifo.is_empty() == true ) ? false : true;
-    spi_packet.header.crc = 0;
-    spi_packet.header.crc = crc8( spi_packet.buf, sizeof(Communications_protocol::Header) + spi_packet.header.size );
+    /*
+     * Take as many packets as fit into one SPI link message directly from the Tx fifo storage, the link copies them into its output
+     * buffer. The packets behind the end of the fifo storage go with the next message. Every packet keeps its own CRC.
+     */
+    spi_packets_count = spi_tx_fifo.peek_span( &p_spi_packets );
+    if ( spi_packets_count > SPI_SLAVE_TX_PACKETS_MAX )
+    {
+        spi_packets_count = SPI_SLAVE_TX_PACKETS_MAX;
+    }
+
+    for ( size_t i = 0; i < spi_packets_count; i++ )
+    {
+        p_spi_packet = &p_spi_packets[i];
+
+        p_spi_packet->header.has_more_packets = ( i + 1 < tx_fifo_items ) ? true : false;
+        p_spi_packet->header.crc = 0;
+        p_spi_packet->header.crc = crc8( p_spi_packet->buf, sizeof(Communications_protocol::Header) + p_spi_packet->header.size );
+    }
 
     /* This is for the possible hazard handling. The receive end callback might theoretically come before the end of the function */
     spils_data_out_sending = true;
-    result = spils_data_send( p_spils, spi_packet.buf, sizeof( spi_packet.buf ) );
-    ASSERT_DYGMA( result == RESULT_OK, "Failure: spils_data_send failed" );
-    EXIT_IF_NOK( result );
+    result = spils_data_send( p_spils, ( const uint8_t * )p_spi_packets, spi_packets_count * sizeof( Communications_protocol::Packet ) );
+    ASSERT_DYGMA( result != RESULT_ERR, "Failure: spils_data_send failed" );
+    EXIT_IF_NOK( result );  /* RESULT_BUSY - the link output is held by the interrupt, the packets stay in the Tx fifo for the next run */
+
+    /* The packets have been copied by the link, they can be released now */
+    spi_tx_fifo.remove_n( spi_packets_count );
+
+    stats.packets_out_count += spi_packets_count;
 
 _EXIT:
     if( result != RESULT_OK )
@@ -259,6 +350,4 @@ _EXIT:
     }
 
     return;
-
-    UNUSED( data_out_len );
 }
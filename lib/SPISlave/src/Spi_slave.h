@@ -66,7 +66,7 @@
 #define __SPI_SLAVE_H__
 
 #include <Communications_protocol.h>
-#include "Fifo_buffer.h"
+#include "Fifo.h"
 #include "link/spi_link_slave.h"
 
 #define SPI_SLAVE_DEBUG                 0
@@ -77,15 +77,55 @@
 #define COMPILE_SPI1_SUPPORT            1
 #define COMPILE_SPI2_SUPPORT            0
 
+#define SPI_SLAVE_TX_BATCH_SUPPORT      1   /* Pack several queued packets into a single SPI link data message */
+
 #define SPI_SLAVE_PACKET_SIZE           sizeof(Communications_protocol::Packet)
 
+/* The link configuration. The host simulator in test/host overrides it to compare the variants */
+#define SPILS_MESSAGE_SIZE_MAX          (SPI_SLAVE_PACKET_SIZE * 4)
+#ifndef SPILS_BUFFERS_IN_COUNT
+#define SPILS_BUFFERS_IN_COUNT          4
+#endif
+
+/*
+ * The number of packets the FIFOs can hold. The rx_fifo takes the messages out of the link input ring only when they
+ * fit, so it needs no more than the packets the ring keeps in flight plus one message for the margin. The tx_fifo is
+ * sized alike, the Neuron keeps the rest of its bursts until sendPacket() accepts them.
+ */
+#define SPI_SLAVE_MESSAGE_PACKETS       (SPILS_MESSAGE_SIZE_MAX / SPI_SLAVE_PACKET_SIZE)
+#ifndef SPI_SLAVE_RX_FIFO_PACKETS
+#define SPI_SLAVE_RX_FIFO_PACKETS       ((SPILS_BUFFERS_IN_COUNT + 1) * SPI_SLAVE_MESSAGE_PACKETS)
+#endif
+#ifndef SPI_SLAVE_TX_FIFO_PACKETS
+#define SPI_SLAVE_TX_FIFO_PACKETS       ((SPILS_BUFFERS_IN_COUNT + 1) * SPI_SLAVE_MESSAGE_PACKETS)
+#endif
+
+#define SPI_SLAVE_PIN_INT_NONE          UINT32_MAX  /* The data-ready INT signal is not used on the port */
+
+typedef struct
+{
+    spils_stats_t link;                 // SPI link layer counters
+
+    uint32_t packets_in_count;          // Packets accepted into the rx_fifo
+    uint32_t packets_out_count;         // Packets sent out from the tx_fifo
+    uint32_t packets_crc_err_count;     // Packets dropped due to the CRC mismatch
+    uint32_t packets_in_dropped_count;  // Packets dropped due to the full rx_fifo
+
+    uint16_t rx_fifo_depth_max;         // Maximal number of packets waiting in the FIFOs
+    uint16_t tx_fifo_depth_max;
+} spi_slave_stats_t;
+
+/* Called for every key packet accepted into the rx_fifo. Defined weak, so the SPI slave does not depend on its users */
+extern void spi_slave_key_packet_received( void );
+
 class Spi_slave {
    public:
     Spi_slave(uint8_t _spi_port,
               uint32_t _miso_pin,
               uint32_t _mosi_pin,
               uint32_t _sck_pin,
-              uint32_t _cs_pin
+              uint32_t _cs_pin,
+              uint32_t _int_pin = SPI_SLAVE_PIN_INT_NONE
             );
 
     void init(void);
@@ -94,8 +134,14 @@ class Spi_slave {
 
     bool_t is_connected(void);
 
-    Fifo_buffer *rx_fifo;
-    Fifo_buffer *tx_fifo;
+    void stats_get(spi_slave_stats_t *p_stats);
+    void stats_reset(void);
+
+    typedef Fifo<Communications_protocol::Packet, SPI_SLAVE_RX_FIFO_PACKETS> rx_fifo_t;
+    typedef Fifo<Communications_protocol::Packet, SPI_SLAVE_TX_FIFO_PACKETS> tx_fifo_t;
+
+    rx_fifo_t *rx_fifo;
+    tx_fifo_t *tx_fifo;
 
    private:
     uint8_t spi_port;
@@ -104,6 +150,7 @@ class Spi_slave {
     uint32_t mosi_pin;
     uint32_t sck_pin;
     uint32_t cs_pin;
+    uint32_t int_pin;                // Data-ready INT signal to the master, SPI_SLAVE_PIN_INT_NONE if not used
 
     uint8_t spi_mode;                // NRF_SPIS_MODE_0, NRF_SPIS_MODE_1, ..
 
@@ -115,9 +162,12 @@ class Spi_slave {
     bool_t spils_data_in_received = false;
     bool_t spils_data_out_sending = false;
 
+    /* Statistics */
+    spi_slave_stats_t stats = {};
+
     /* Buffers */
-    Fifo_buffer spi_rx_fifo = Fifo_buffer(SPI_SLAVE_PACKET_SIZE);
-    Fifo_buffer spi_tx_fifo = Fifo_buffer(SPI_SLAVE_PACKET_SIZE);
+    rx_fifo_t spi_rx_fifo;
+    tx_fifo_t spi_tx_fifo;
 
     static void spils_event_handler( void * p_instance, spils_event_type_t event_type );
 
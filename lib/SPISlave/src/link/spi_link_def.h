@@ -69,6 +69,10 @@ typedef struct
     uint8_t data[];
 } PACK spil_mess_data_t;
 
+/*
+ * With the data piggyback enabled, the result message may be directly followed by a whole SPIL_MESS_TYPE_DATA message.
+ * In that case the result head.len covers both messages.
+ */
 typedef struct
 {
     spil_mess_header_t head;
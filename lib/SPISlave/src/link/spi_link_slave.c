@@ -69,17 +69,23 @@ struct spils
 
     /* GPIO */
     bool_t pin_int_enabled;
-//    hal_mcu_gpio_t * p_pin_int;  /* Interrupt signal */
+    hal_mcu_gpio_t * p_pin_int;  /* Interrupt signal */
 
     /* Buffers */
     buffer_t * p_buffer_in_cache;     /* The pointer for input buffer into which the data is currently being transmitted in */
-    buffer_t * p_buffer_in;           /* The pointer for input buffer which can be read from superior layers */
+    buffer_t ** pp_buffers_in;        /* The ring of input buffers which can be read from superior layers */
+    uint8_t buffers_in_count;         /* The number of buffers in the input ring */
+    uint8_t buffers_in_head;          /* The ring position which will be filled by the next input cache swap */
+    uint8_t buffers_in_tail;          /* The ring position which will be read next by superior layers */
+    uint8_t buffers_in_loaded;        /* The number of input ring buffers holding unread data */
 
     buffer_t * p_buffer_out_cache;    /* The pointer for output buffer from which the data is currently being transmitted out */
     buffer_t * p_buffer_out;          /* The pointer for output buffer which can be written from superior layers */
 
     /* Messages */
     uint8_t message_size_max;
+    bool_t data_piggyback_enabled;
+    uint16_t data_piggyback_len;      /* The length of the listening message carrying the output data, 0 if none is pending */
 
     /* Mutexes */
     mutex_t * p_mutex_in;
@@ -97,6 +103,14 @@ struct spils
     uint32_t disconnect_timeout_ms;     /* Set 0 to disable */
     dl_timer_t disconnect_timer;        /* Time threshold for disconnect timer */
 
+    /* Deferred transfer processing */
+    bool_t transfer_done_deferred;
+    volatile bool_t transfer_done_pending;                  /* Set from the interrupt, cleared from spils_poll */
+    hal_mcu_spi_transfer_result_t transfer_result_pending;
+
+    /* Statistics */
+    spils_stats_t stats;
+
     /* Event handlers */
     void * p_instance;
     spils_event_handler_t event_handler;
@@ -143,52 +157,61 @@ _EXIT:
 
 static result_t _gpio_init( spils_t * p_spils, const spils_conf_t * p_conf )
 {
-//    result_t result = RESULT_ERR;
-//    hal_mcu_gpio_conf_t config;
+    result_t result = RESULT_ERR;
+    hal_mcu_gpio_conf_t config;
 
-    ASSERT_DYGMA( p_conf->pin_int_enable == false, "The SPI Link Slave INT pin is currently not supported" );
-    p_spils->pin_int_enabled = false;
+    /**************/
+    /* INT signal */
+    /**************/
+    if( p_conf->pin_int_enable == false )
+    {
+        p_spils->pin_int_enabled = false;
+        p_spils->p_pin_int = NULL;
+        return RESULT_OK;
+    }
 
-    return RESULT_OK;
+    /* Pin configuration */
+    config.pin = p_conf->pin_int;
+    config.direction = HAL_MCU_GPIO_DIR_OUTPUT;
+    config.dir_conf.output.init_val = false;       /* The INT signal is initially reset. */
+
+    result = hal_mcu_gpio_init( &p_spils->p_pin_int, &config );
+    EXIT_IF_ERR( result, "hal_mcu_gpio_init failed" );
 
-//    /**************/
-//    /* INT signal */
-//    /**************/
-//    if( p_conf->pin_int_enable == false )
-//    {
-//        p_spils->pin_int_enabled = false;
-//        p_spils->p_pin_int = NULL;
-//        return RESULT_OK;
-//    }
-//
-//    /* Pin configuration */
-//    config.pin = p_conf->pin_int;
-//    config.direction = HAL_MCU_GPIO_DIR_OUTPUT;
-//    config.dir_conf.output.init_val = false;       /* The INT signal is initially reset. */
-//
-//    result = hal_mcu_gpio_init( &p_spils->p_pin_int, &config );
-//    EXIT_IF_ERR( result, "hal_mcu_gpio_init failed" );
-//
-//    p_spils->pin_int_enabled = true;
-//
-//_EXIT:
-//    return result;
+    p_spils->pin_int_enabled = true;
+
+_EXIT:
+    return result;
 }
 
 static result_t _buffers_init( spils_t * p_spils, const spils_conf_t * p_conf )
 {
     result_t result = RESULT_ERR;
 
-    ASSERT_DYGMA( p_conf->message_size_max <= UINT8_MAX - sizeof( spil_mess_header_t ), "FATAL: SPI link message_size_max exceeds the maximum possible value" );
+    /* With the data piggyback, the output cache must hold the result message followed by the whole data message */
+    uint8_t buffer_overhead = sizeof( spil_mess_header_t ) + ( ( p_conf->data_piggyback_enable == true ) ? sizeof( spil_mess_result_t ) : 0 );
+
+    ASSERT_DYGMA( p_conf->message_size_max <= UINT8_MAX - buffer_overhead, "FATAL: SPI link message_size_max exceeds the maximum possible value" );
 
     /* Compute the size of buffers */
-    uint8_t buffer_size = p_conf->message_size_max + sizeof( spil_mess_header_t );
+    uint8_t buffer_size = p_conf->message_size_max + buffer_overhead;
 
     result = buffer_init( &p_spils->p_buffer_in_cache, buffer_size );
     EXIT_IF_ERR( result, "buffer_init for buffer_in_cache failed" );
 
-    result = buffer_init( &p_spils->p_buffer_in, buffer_size );
-    EXIT_IF_ERR( result, "buffer_init for buffer_in failed" );
+    /* Input ring. At least one buffer is needed to pass the data to superior layers */
+    p_spils->buffers_in_count = ( p_conf->buffers_in_count == 0 ) ? 1 : p_conf->buffers_in_count;
+    p_spils->pp_buffers_in = heap_alloc( p_spils->buffers_in_count * sizeof( buffer_t * ) );
+
+    for( uint8_t i = 0; i < p_spils->buffers_in_count; i++ )
+    {
+        result = buffer_init( &p_spils->pp_buffers_in[i], buffer_size );
+        EXIT_IF_ERR( result, "buffer_init for buffers_in failed" );
+    }
+
+    p_spils->buffers_in_head = 0;
+    p_spils->buffers_in_tail = 0;
+    p_spils->buffers_in_loaded = 0;
 
     result = buffer_init( &p_spils->p_buffer_out_cache, buffer_size );
     EXIT_IF_ERR( result, "buffer_init for buffer_out_cache failed" );
@@ -218,6 +241,8 @@ static result_t _init( spils_t * p_spils, const spils_conf_t * p_conf )
 
     /* Messages */
     p_spils->message_size_max = p_conf->message_size_max;
+    p_spils->data_piggyback_enabled = p_conf->data_piggyback_enable;
+    p_spils->data_piggyback_len = 0;
 
     /* Initialize the Mutexes */
     mutex_init( &p_spils->p_mutex_in );
@@ -235,6 +260,13 @@ static result_t _init( spils_t * p_spils, const spils_conf_t * p_conf )
     p_spils->disconnect_timeout_ms = p_conf->disconnect_timeout_ms;
     p_spils->disconnect_timer = 0;
 
+    /* Deferred transfer processing */
+    p_spils->transfer_done_deferred = p_conf->transfer_done_deferred;
+    p_spils->transfer_done_pending = false;
+
+    /* Statistics */
+    memset( &p_spils->stats, 0x00, sizeof( p_spils->stats ) );
+
     _disconnect_timer_reset( p_spils );
 
     /* Event handlers */
@@ -367,10 +399,10 @@ static result_t _int_signal_set( spils_t * p_spils )
         return RESULT_OK;
     }
 
-//    result = hal_mcu_gpio_out( p_spils->p_pin_int, true );
-//    EXIT_IF_ERR( result, "hal_mcu_gpio_out failed" );
+    result = hal_mcu_gpio_out( p_spils->p_pin_int, true );
+    EXIT_IF_ERR( result, "hal_mcu_gpio_out failed" );
 
-//_EXIT:
+_EXIT:
     return result;
 }
 
@@ -383,10 +415,10 @@ static result_t _int_signal_reset( spils_t * p_spils )
         return RESULT_OK;
     }
 
-//    result = hal_mcu_gpio_out( p_spils->p_pin_int, false );
-//    EXIT_IF_ERR( result, "hal_mcu_gpio_out failed" );
+    result = hal_mcu_gpio_out( p_spils->p_pin_int, false );
+    EXIT_IF_ERR( result, "hal_mcu_gpio_out failed" );
 
-//_EXIT:
+_EXIT:
     return result;
 }
 
@@ -555,13 +587,30 @@ static INLINE void _buffer_recycle( buffer_t * p_buffer )
     buffer_clear( p_buffer );
 }
 
+static INLINE buffer_t * _buffer_in_ring_tail_get( spils_t * p_spils )
+{
+    return p_spils->pp_buffers_in[ p_spils->buffers_in_tail ];
+}
+
+static INLINE void _buffer_in_ring_tail_release( spils_t * p_spils )
+{
+    _buffer_recycle( _buffer_in_ring_tail_get( p_spils ) );
+
+    p_spils->buffers_in_tail = ( p_spils->buffers_in_tail + 1 ) % p_spils->buffers_in_count;
+    p_spils->buffers_in_loaded--;
+}
+
 static INLINE void _buffer_in_cache_swap( spils_t * p_spils )
 {
     buffer_t * _temp_buffer;
 
-    _temp_buffer = p_spils->p_buffer_in;
-    p_spils->p_buffer_in = p_spils->p_buffer_in_cache;
+    /* The cache takes the place of the empty buffer at the head of the ring */
+    _temp_buffer = p_spils->pp_buffers_in[ p_spils->buffers_in_head ];
+    p_spils->pp_buffers_in[ p_spils->buffers_in_head ] = p_spils->p_buffer_in_cache;
     p_spils->p_buffer_in_cache = _temp_buffer;
+
+    p_spils->buffers_in_head = ( p_spils->buffers_in_head + 1 ) % p_spils->buffers_in_count;
+    p_spils->buffers_in_loaded++;
 }
 
 static result_t _buffer_in_cache_data_move( spils_t * p_spils )
@@ -588,15 +637,15 @@ static result_t _buffer_in_cache_data_move( spils_t * p_spils )
         goto _EXIT;
     }
 
-    if( buffer_get_loadsize( p_spils->p_buffer_in ) != 0 )
+    if( p_spils->buffers_in_loaded == p_spils->buffers_in_count )
     {
-        /* There is still unprocessed data in the buffer_in. So the line is getting saturated */
+        /* All the input ring buffers still hold unprocessed data. So the line is getting saturated */
 
         result = RESULT_BUSY;
         goto _EXIT;
     }
 
-    /* There is valid data in the cache and space in the buffer_in. So let's do the swap */
+    /* There is valid data in the cache and space in the input ring. So let's do the swap */
 
     _buffer_in_cache_swap( p_spils );
 
@@ -663,6 +712,31 @@ static void _mess_compose_result( spils_t * p_spils, buffer_t * p_buffer, spil_m
     p_mess_result->head.type = transfer_result;
 
     buffer_update_write_pos( p_buffer, p_mess_result->head.len );
+
+    /* Statistics */
+    switch( transfer_result )
+    {
+        case SPIL_MESS_TYPE_RESULT_ERR:
+
+            p_spils->stats.result_err_count++;
+
+            break;
+
+        case SPIL_MESS_TYPE_RESULT_BUSY:
+
+            p_spils->stats.result_busy_count++;
+
+            break;
+
+        case SPIL_MESS_TYPE_RESULT_OK_BUSY:
+
+            p_spils->stats.result_ok_busy_count++;
+
+            break;
+
+        default:
+            break;
+    }
 }
 
 static result_t _mess_compose_data( spils_t * p_spils, buffer_t * p_buffer, const uint8_t * p_data, uint8_t data_len )
@@ -701,6 +775,69 @@ _EXIT:
     return result;
 }
 
+static void _mess_append_data_out( spils_t * p_spils, buffer_t * p_buffer )
+{
+    result_t result = RESULT_ERR;
+    spil_mess_result_t * p_mess_result;
+    uint16_t data_out_loadsize;
+
+    /* Try to lock the output stream */
+    if ( _mutex_out_trylock( p_spils ) == false )
+    {
+        return;
+    }
+
+    /*
+     * The prepared data message is copied behind the result message, but it is kept in the buffer_out until the master
+     * confirms it has clocked the whole listening message out. Otherwise it will be sent again the usual way.
+     */
+    data_out_loadsize = buffer_get_loadsize( p_spils->p_buffer_out );
+
+    result = buffer_add( p_buffer, buffer_get_load_space_pointer( p_spils->p_buffer_out, 0 ), data_out_loadsize );
+    ASSERT_DYGMA( result == RESULT_OK, "SPI slave driver piggyback data exceedes available space" );
+    EXIT_IF_ERR( result, "buffer_add failed" );
+
+    /* The result message length covers the appended data message, so the master knows it is there */
+    p_mess_result = (spil_mess_result_t *)buffer_get_load_space_pointer( p_buffer, 0 );
+    p_mess_result->head.len += data_out_loadsize;
+
+    p_spils->data_piggyback_len = buffer_get_loadsize( p_buffer );
+
+_EXIT:
+    /* Unlock the output stream */
+    _mutex_out_unlock( p_spils );
+}
+
+static void _data_piggyback_done( spils_t * p_spils, hal_mcu_spi_transfer_result_t * p_transfer_result )
+{
+    uint16_t data_piggyback_len = p_spils->data_piggyback_len;
+
+    p_spils->data_piggyback_len = 0;
+
+    /*
+     * The master clocks out as many bytes as it sends in. If it did not clock the whole listening message, it did not
+     * receive the appended data and the data stays in the buffer_out to be sent again.
+     */
+    if( p_transfer_result->data_in_len < data_piggyback_len )
+    {
+        return;
+    }
+
+    /* Try to lock the output stream. It is not expected to fail as spils_data_send does not lock while data_out_available is set */
+    if ( _mutex_out_trylock( p_spils ) == false )
+    {
+        return;
+    }
+
+    _buffer_recycle( p_spils->p_buffer_out );
+    p_spils->data_out_available = false;
+
+    /* Unlock the output stream */
+    _mutex_out_unlock( p_spils );
+
+    _event_handler( p_spils, SPILS_EVENT_TYPE_DATA_OUT_SENT );
+}
+
 /*************************/
 /*       Transfer        */
 /*************************/
@@ -815,6 +952,7 @@ static INLINE void _transfer_send_data_start( spils_t * p_spils )
     if( buffer_get_loadsize( p_spils->p_buffer_out_cache ) == 0 )
     {
         _mess_compose_data( p_spils, p_spils->p_buffer_out_cache, NULL, 0 );
+        p_spils->stats.transfer_idle_count++;
     }
 
 _EXIT:
@@ -877,6 +1015,7 @@ static INLINE void _transfer_receive_data( spils_t * p_spils )
 
         transfer_result = SPIL_MESS_TYPE_RESULT_OK_BUSY;
         p_spils->line_in_busy = true;
+        p_spils->stats.line_in_busy_count++;
     }
     else
     {
@@ -918,6 +1057,7 @@ static INLINE void _transfer_data_in_process( spils_t * p_spils, hal_mcu_spi_tra
     if( p_spils->line_in_busy == true || p_spils->line_in_is_saturated )
     {
         /* The input data line is still saturated. */
+        p_spils->stats.line_in_saturated_count++;
 
         _listening_start( p_spils, SPIL_MESS_TYPE_RESULT_BUSY );
 
@@ -937,6 +1077,7 @@ static INLINE void _transfer_data_in_process( spils_t * p_spils, hal_mcu_spi_tra
 
     /* Update the incoming buffer space */
     buffer_update_write_pos( p_spils->p_buffer_in_cache, _transfer_result->data_in_len );
+    p_spils->stats.bytes_in_count += _transfer_result->data_in_len;
 
     /* Get the message header */
     p_message_in_header = (spil_mess_header_t * )buffer_get_load_space_pointer( p_spils->p_buffer_in_cache, 0 );
@@ -963,6 +1104,9 @@ static INLINE void _transfer_data_in_process( spils_t * p_spils, hal_mcu_spi_tra
 
         default:
 
+            /* The master has only polled the line */
+            p_spils->stats.transfer_idle_count++;
+
             _buffer_recycle( p_spils->p_buffer_in_cache );
 
             if( p_spils->state == SPILS_STATE_DATA_RECEIVING )
@@ -988,6 +1132,7 @@ static INLINE void _transfer_data_in_process( spils_t * p_spils, hal_mcu_spi_tra
 static INLINE void _transfer_data_out_process( spils_t * p_spils, hal_mcu_spi_transfer_result_t * p_transfer_result )
 {
     /* We assume the data has been clocked out by the SPI master. So we clear the Tx buffer for the next use */
+    p_spils->stats.bytes_out_count += p_transfer_result->data_out_len;
 
     _buffer_recycle( p_spils->p_buffer_out_cache );
 
@@ -995,6 +1140,10 @@ static INLINE void _transfer_data_out_process( spils_t * p_spils, hal_mcu_spi_tr
     {
         _event_handler( p_spils, SPILS_EVENT_TYPE_DATA_OUT_SENT );
     }
+    else if( p_spils->data_piggyback_len != 0 )
+    {
+        _data_piggyback_done( p_spils, p_transfer_result );
+    }
 }
 
 static void _spi_slave_buffers_set_done_handler( spils_t * p_spils )
@@ -1024,10 +1173,11 @@ static void _spi_slave_buffers_set_done_handler( spils_t * p_spils )
     }
 }
 
-static void _spi_slave_transfer_done_handler( spils_t * p_spils, hal_mcu_spi_transfer_result_t * p_transfer_result )
+static void _transfer_done_process( spils_t * p_spils, hal_mcu_spi_transfer_result_t * p_transfer_result )
 {
     /* Set the connection_detected flag */
     p_spils->connection_detected = true;
+    p_spils->stats.transfer_count++;
 
     /* Reset the INT signal - the SPI interface is not active now */
     _int_signal_reset( p_spils );
@@ -1039,6 +1189,48 @@ static void _spi_slave_transfer_done_handler( spils_t * p_spils, hal_mcu_spi_tra
     _transfer_data_in_process( p_spils, p_transfer_result );
 }
 
+static void _spi_slave_transfer_done_handler( spils_t * p_spils, hal_mcu_spi_transfer_result_t * p_transfer_result )
+{
+    if( p_spils->transfer_done_deferred == false )
+    {
+        _transfer_done_process( p_spils, p_transfer_result );
+        return;
+    }
+
+    /*
+     * Only keep the result for spils_poll. The SPI stays disabled until the next transfer is started from there, so there can not be
+     * another transfer done event in the meantime.
+     */
+    ASSERT_DYGMA( p_spils->transfer_done_pending == false, "SPI link slave - the previous transfer has not been processed yet" );
+
+    /* The slave is not armed until spils_poll processes the result, the master must not be signalled meanwhile */
+    _int_signal_reset( p_spils );
+
+    p_spils->transfer_result_pending = *p_transfer_result;
+    __asm volatile( "" ::: "memory" );
+    p_spils->transfer_done_pending = true;
+}
+
+static INLINE void _transfer_done_pending_process( spils_t * p_spils )
+{
+    hal_mcu_spi_transfer_result_t transfer_result;
+
+    if( p_spils->transfer_done_pending == false )
+    {
+        return;
+    }
+
+    /*
+     * Take the result over before processing it. The processing starts the next transfer, and its done event may come from the
+     * interrupt before the processing returns.
+     */
+    transfer_result = p_spils->transfer_result_pending;
+    __asm volatile( "" ::: "memory" );
+    p_spils->transfer_done_pending = false;
+
+    _transfer_done_process( p_spils, &transfer_result );
+}
+
 
 static result_t _transfer_start( spils_t * p_spils, spils_state_t state )
 {
@@ -1081,6 +1273,16 @@ static void _listening_start( spils_t * p_spils, spil_mess_type_t result_mess_ty
     /* Prepare the response message */
     _mess_compose_result( p_spils, p_spils->p_buffer_out_cache, result_mess_type );
 
+    /*
+     * Append the pending output data directly to the result, so the master gets it within this transaction. This is done only when
+     * the input is not saturated, as the received data length is the only proof of how many bytes the master has clocked out.
+     */
+    if( p_spils->data_piggyback_enabled == true && p_spils->data_out_available == true &&
+        buffer_get_loadsize( p_spils->p_buffer_in_cache ) == 0 )
+    {
+        _mess_append_data_out( p_spils, p_spils->p_buffer_out_cache );
+    }
+
     /* Start the transfer */
     result = _transfer_start( p_spils, SPILS_STATE_LISTENING_START );
     ASSERT_DYGMA( result == RESULT_OK, "The start of the SPI slave listening failed. This should not happen." );
@@ -1130,6 +1332,7 @@ static INLINE void _con_state_set_connected( spils_t * p_spils )
     /* Set the connected state */
     _disconnect_timer_reset( p_spils );
     _con_state_set( p_spils, SPILS_CON_STATE_CONNECTED );
+    p_spils->stats.connect_count++;
 
     /* Report the connection event */
     _event_handler( p_spils, SPILS_EVENT_TYPE_CONNECTED );
@@ -1142,6 +1345,7 @@ static INLINE void _con_state_set_disconnected( spils_t * p_spils )
 
     /* Set the disconnected state */
     _con_state_set( p_spils, SPILS_CON_STATE_DISCONNECTED );
+    p_spils->stats.disconnect_count++;
 
     /* Report the disconnection event */
     _event_handler( p_spils, SPILS_EVENT_TYPE_DISCONNECTED );
@@ -1257,15 +1461,14 @@ result_t spils_data_read( spils_t * p_spils, uint8_t * p_data, uint16_t * p_data
         return RESULT_BUSY;
     }
 
-    /* Get the data. */
-    *p_data_size = buffer_get_loadsize( p_spils->p_buffer_in );
-    result = buffer_get_and_discard( p_spils->p_buffer_in, p_data, *p_data_size );
+    /* Get the data from the oldest buffer of the input ring. */
+    *p_data_size = buffer_get_loadsize( _buffer_in_ring_tail_get( p_spils ) );
+    result = buffer_get_and_discard( _buffer_in_ring_tail_get( p_spils ), p_data, *p_data_size );
     EXIT_IF_ERR( result, "buffer_get_and_discard failed." );
 
-    /* Recycle the buffer_in */
-    _buffer_recycle( p_spils->p_buffer_in );
-    p_spils->data_in_available = false;
-
+    /* Recycle the buffer and move to the next one */
+    _buffer_in_ring_tail_release( p_spils );
+    p_spils->data_in_available = ( p_spils->buffers_in_loaded != 0 );
 
 _EXIT:
     /* Unlock the input stream */
@@ -1274,6 +1477,58 @@ _EXIT:
     return result;
 }
 
+result_t spils_data_borrow( spils_t * p_spils, uint8_t ** pp_data, uint16_t * p_data_size )
+{
+    buffer_t * p_buffer_in;
+
+    if( p_spils->data_in_available == false )
+    {
+        *pp_data = NULL;
+        *p_data_size = 0;
+        return RESULT_OK;
+    }
+
+    /* Try to lock the input data stream */
+    if ( _mutex_in_trylock( p_spils ) == false )
+    {
+        return RESULT_BUSY;
+    }
+
+    /*
+     * The oldest buffer of the input ring is lent to the superior layer as it is. The transfer process only ever swaps
+     * the cache into the ring head, which cannot be the loaded tail, so the buffer stays intact until spils_data_release.
+     */
+    p_buffer_in = _buffer_in_ring_tail_get( p_spils );
+
+    *pp_data = buffer_get_load_space_pointer( p_buffer_in, 0 );
+    *p_data_size = buffer_get_loadsize( p_buffer_in );
+
+    /* Unlock the input stream */
+    _mutex_in_unlock( p_spils );
+
+    return RESULT_OK;
+}
+
+result_t spils_data_release( spils_t * p_spils )
+{
+    ASSERT_DYGMA( p_spils->data_in_available == true, "spils_data_release called without borrowed data" );
+
+    /* Try to lock the input data stream */
+    if ( _mutex_in_trylock( p_spils ) == false )
+    {
+        return RESULT_BUSY;
+    }
+
+    /* Recycle the buffer and move to the next one */
+    _buffer_in_ring_tail_release( p_spils );
+    p_spils->data_in_available = ( p_spils->buffers_in_loaded != 0 );
+
+    /* Unlock the input stream */
+    _mutex_in_unlock( p_spils );
+
+    return RESULT_OK;
+}
+
 result_t spils_data_send( spils_t * p_spils, const uint8_t * p_data, uint16_t data_size )
 {
     result_t result = RESULT_ERR;
@@ -1294,27 +1549,32 @@ result_t spils_data_send( spils_t * p_spils, const uint8_t * p_data, uint16_t da
     EXIT_IF_ERR( result, "_mess_compose_data failed" );
     p_spils->data_out_available = true;
 
-    /* WARNING: POSSIBLE HAZARD HERE
-     * Setting the INT signal here may result in undesired and wrong signaling in case the SPI interrupt comes
-     * before the INT signal is actually set. After the interrupt, the INT signal should be reset until the next
-     * _spi_slave_buffers_set_done_handler. The SPI master will then be mistaken and might try a transfer which
-     * will be ignored due to the SPI slave being configured still.
-     *
-     * Mutex does not solve this situation nor temporarily disabling the SPI interrupt.
-     *
-     * This situation is the choice whether we will be asynchronously signaling the new available data or not.
-     * We will have to watch the SPI slave behavior and see how critical this issue could be.
+    /*
+     * NOTE: The SPI interrupt may come anywhere around the INT signal set below. The data_out_available flag is already set at
+     *       that point, so:
+     *       - Without the deferred transfer processing, the transfer_done handler resets the INT signal first and the following
+     *         _set_state sets it again as soon as the slave is re-armed in the LISTENING state (or in the DATA_RECEIVING/DATA_SENDING
+     *         state, where the INT signal is set anyway). The *_START states, in which the INT signal must stay reset, exist only
+     *         within the interrupt context. Setting it here once more does not change anything.
+     *       - With the deferred transfer processing, the interrupt resets the INT signal and leaves the slave disarmed in the
+     *         LISTENING state until spils_poll, which runs in the same context as this function, processes the transfer. The INT
+     *         signal is not set while a transfer is pending, and it is taken back if the interrupt came between the check and the set.
      *
-     * SUGGESTED SOLUTION: Forcefully finishing the current transfer process (Is it possible? What happens if the data
-     *                     is actually in the middle of the transition? ) and invoking the transfer_done handler to
-     *                     set a new transfer and the INT signal accordingly.
-     *                     This way there would be still some ignored messages during the SPI slave transfer reconfiguration,
-     *                     but the INT signal would be handled correctly.
+     *       The INT signal is thus never left set while the slave is not ready for the next transfer. The SPI master should
+     *       still react on the INT signal only after the chip select has been released for a while, as the signal gets reset
+     *       with the interrupt latency after the end of the transfer.
      */
+    __asm volatile( "" ::: "memory" );
 
-    if ( p_spils->state == SPILS_STATE_LISTENING )
+    if ( p_spils->state == SPILS_STATE_LISTENING && p_spils->transfer_done_pending == false )
     {
         _int_signal_set( p_spils );
+
+        __asm volatile( "" ::: "memory" );
+        if( p_spils->transfer_done_pending == true )
+        {
+            _int_signal_reset( p_spils );
+        }
     }
 
 _EXIT:
@@ -1324,8 +1584,24 @@ _EXIT:
     return result;
 }
 
+void spils_stats_get( spils_t * p_spils, spils_stats_t * p_stats )
+{
+    *p_stats = p_spils->stats;
+
+    hal_mcu_spi_slave_stats_get( p_spils->p_spi, &p_stats->spi );
+}
+
+void spils_stats_reset( spils_t * p_spils )
+{
+    /* NOTE: The counters are updated from the SPI interrupt as well. A count coming in the middle of the reset might be lost, which is fine for statistics */
+    memset( &p_spils->stats, 0x00, sizeof( p_spils->stats ) );
+
+    hal_mcu_spi_slave_stats_reset( p_spils->p_spi );
+}
+
 void spils_poll( spils_t * p_spils )
 {
+    _transfer_done_pending_process( p_spils );
     _con_machine( p_spils );
     _line_in_busy_process( p_spils );
 }
@@ -67,26 +67,66 @@ typedef struct
 
     /* GPIO */
     bool_t pin_int_enable;
-//    hal_mcu_gpio_pin_t pin_int;     /* INT output pin. Will be used only if the pin_int_enable is true */
+    hal_mcu_gpio_pin_t pin_int;     /* INT output pin. Will be used only if the pin_int_enable is true */
 
     /* Messages */
     uint8_t message_size_max;
+    bool_t data_piggyback_enable;       /* Append the pending output data to the listening result messages. Requires the master support */
+
+    /* Buffers */
+    uint8_t buffers_in_count;           /* Number of received messages which can wait for the superior layers to be read */
 
     /* Connection */
     uint32_t disconnect_timeout_ms;     /* Set 0 to disable */
 
+    /*
+     * Transfer processing. When true, the transfer done interrupt only captures the transfer result and the link layer processes it
+     * (and starts the next transfer) from spils_poll. This shortens the interrupt at the cost of the time until spils_poll is called.
+     */
+    bool_t transfer_done_deferred;
+
     /* Event handlers */
     void * p_instance;
     spils_event_handler_t event_handler;
 
 } spils_conf_t;
 
+typedef struct
+{
+    uint32_t transfer_count;            /* All the valid transfers clocked by the master */
+    uint32_t transfer_idle_count;       /* Transfers in which the master only polled the line and no data was exchanged */
+
+    uint32_t bytes_in_count;            /* Bytes received from the master */
+    uint32_t bytes_out_count;           /* Bytes handed over to the SPI peripheral for the master */
+
+    uint32_t result_err_count;          /* Result messages by type */
+    uint32_t result_busy_count;
+    uint32_t result_ok_busy_count;
+
+    uint32_t line_in_busy_count;        /* Messages accepted with the OK_BUSY result as all the input buffers were full */
+    uint32_t line_in_saturated_count;   /* Transfers refused with the BUSY result until the input buffers got freed */
+
+    uint32_t connect_count;
+    uint32_t disconnect_count;
+
+    hal_mcu_spi_slave_stats_t spi;      /* SPI peripheral re-arm statistics */
+} spils_stats_t;
+
 typedef struct spils spils_t;
 
 extern result_t spils_init( spils_t ** pp_spils, const spils_conf_t * p_conf );
 extern bool_t spils_data_read_available( spils_t * p_spils );
 extern result_t spils_data_read( spils_t * p_spils, uint8_t * p_data, uint16_t * p_data_size );
+
+/*
+ * Zero-copy alternative to spils_data_read. spils_data_borrow provides the pointer into the oldest received message,
+ * which stays valid and untouched by the link until spils_data_release is called.
+ */
+extern result_t spils_data_borrow( spils_t * p_spils, uint8_t ** pp_data, uint16_t * p_data_size );
+extern result_t spils_data_release( spils_t * p_spils );
 extern result_t spils_data_send( spils_t * p_spils, const uint8_t * p_data, uint16_t data_size );
+extern void spils_stats_get( spils_t * p_spils, spils_stats_t * p_stats );
+extern void spils_stats_reset( spils_t * p_spils );
 
 extern void spils_poll( spils_t * p_spils );
 
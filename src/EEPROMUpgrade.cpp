@@ -83,12 +83,16 @@ EventHandlerResult EEPROMUpgrade::beforeEachCycle() {
     need_update_ = EEPROM.getNeedUpdate();
     if (need_update_) {
       start_time_ = Runtime.millisAtCycleStart();
+    } else if (Runtime.hasTimeExpired(maintenance_time_, 1000)) {
+      // Erase the flash freed by the last compaction a sector at a time, away from the commits
+      maintenance_time_ = Runtime.millisAtCycleStart();
+      EEPROM.maintenance();
     }
     return EventHandlerResult::OK;
   }
 
-  if (Runtime.hasTimeExpired(start_time_, 500)) {
-    EEPROM.update();
+  // One flash operation per cycle, the keys keep being scanned and reported in between
+  if (Runtime.hasTimeExpired(start_time_, 500) && !EEPROM.updateStep()) {
     need_update_ = false;
   }
   return EventHandlerResult::OK;
@@ -33,6 +33,7 @@ class EEPROMUpgrade: public Plugin {
  private:
   bool need_update_;
   uint16_t start_time_{0};
+  uint16_t maintenance_time_{0};
   static uint16_t settings_base_;
   static uint8_t version_;
 };
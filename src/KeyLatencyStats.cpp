@@ -0,0 +1,82 @@
+/* -*- mode: c++ -*-
+ * kaleidoscope::plugin::KeyLatencyStats -- Report the key latency histograms via Focus
+ * Copyright (C) 2024  Dygma Lab S.L.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Kaleidoscope.h"
+#include "Kaleidoscope-FocusSerial.h"
+#include "KeyLatencyStats.h"
+#include "KeyLatency.h"
+#include "Spi_slave.h"
+
+/* Timestamp the key packets accepted by the SPI slaves */
+void spi_slave_key_packet_received(void) {
+  KeyLatency::keyPacketReceived();
+}
+
+namespace kaleidoscope {
+namespace plugin {
+
+static void sendStats(const KeyLatency::Stats &stats) {
+  ::Focus.send(stats.count,
+               stats.min_us,
+               stats.avg_us,
+               stats.p99_us,
+               stats.max_us);
+  ::Focus.sendRaw(F("\r\n"));
+}
+
+/*
+ * latency.stats prints two lines, in microseconds:
+ *   count min avg p99 max    from the key packet arrival to the keyboard report being queued
+ *   count min avg p99 max    from the key packet arrival to the keyboard report being delivered to the host
+ */
+EventHandlerResult KeyLatencyStats::onFocusEvent(const char *command) {
+  if (::Focus.handleHelp(command, PSTR("latency.stats\nlatency.statsReset")))
+    return EventHandlerResult::OK;
+
+  if (strncmp_P(command, PSTR("latency."), 8) != 0)
+    return EventHandlerResult::OK;
+
+  if (strcmp_P(command + 8, PSTR("stats")) == 0) {
+    KeyLatency::Stats stats;
+
+    KeyLatency::getQueueStats(stats);
+    sendStats(stats);
+    KeyLatency::getTotalStats(stats);
+    sendStats(stats);
+  } else if (strcmp_P(command + 8, PSTR("statsReset")) == 0) {
+    KeyLatency::resetStats();
+  } else {
+    return EventHandlerResult::OK;
+  }
+
+  return EventHandlerResult::EVENT_CONSUMED;
+}
+
+/*
+ * The key packets are received by Communications.run() after the cycle, and the keyboard report they cause is sent during
+ * the next one. A timestamp still pending at the end of that cycle belongs to a packet which changed no keyboard report.
+ */
+EventHandlerResult KeyLatencyStats::afterEachCycle() {
+  KeyLatency::keyTimeDiscard();
+
+  return EventHandlerResult::OK;
+}
+
+}  // namespace plugin
+}  // namespace kaleidoscope
+
+kaleidoscope::plugin::KeyLatencyStats KeyLatencyStats;
@@ -0,0 +1,36 @@
+/* -*- mode: c++ -*-
+ * kaleidoscope::plugin::KeyLatencyStats -- Report the key latency histograms via Focus
+ * Copyright (C) 2024  Dygma Lab S.L.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Kaleidoscope.h"
+
+namespace kaleidoscope {
+namespace plugin {
+
+class KeyLatencyStats : public Plugin {
+ public:
+  KeyLatencyStats() {}
+
+  EventHandlerResult onFocusEvent(const char *command);
+  EventHandlerResult afterEachCycle();
+};
+
+}  // namespace plugin
+}  // namespace kaleidoscope
+
+extern kaleidoscope::plugin::KeyLatencyStats KeyLatencyStats;
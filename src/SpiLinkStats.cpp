@@ -0,0 +1,94 @@
+/* -*- mode: c++ -*-
+ * kaleidoscope::plugin::SpiLinkStats -- Report the SPI link statistics via Focus
+ * Copyright (C) 2020  Dygma Lab S.L.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Kaleidoscope.h"
+#include "Kaleidoscope-FocusSerial.h"
+#include "SpiLinkStats.h"
+#include "SpiPort.h"
+
+namespace kaleidoscope {
+namespace plugin {
+
+static const uint8_t spi_ports[] = {0, 1};
+
+/*
+ * spi.stats prints one line per SPI port:
+ *   port transfers idle_transfers bytes_in bytes_out result_err result_busy result_ok_busy
+ *   line_in_busy line_in_saturated connects disconnects packets_in packets_out crc_errors
+ *   rx_dropped rx_fifo_max tx_fifo_max rearm_fast rearm_reset rearm_last_us rearm_max_us
+ *   irq_max_us done_max_us
+ */
+static void sendStats(uint8_t port) {
+  spi_slave_stats_t stats;
+  SpiPort(port).getStats(stats);
+
+  ::Focus.send(port,
+               stats.link.transfer_count,
+               stats.link.transfer_idle_count,
+               stats.link.bytes_in_count,
+               stats.link.bytes_out_count,
+               stats.link.result_err_count,
+               stats.link.result_busy_count,
+               stats.link.result_ok_busy_count,
+               stats.link.line_in_busy_count,
+               stats.link.line_in_saturated_count,
+               stats.link.connect_count,
+               stats.link.disconnect_count);
+  ::Focus.send(stats.packets_in_count,
+               stats.packets_out_count,
+               stats.packets_crc_err_count,
+               stats.packets_in_dropped_count,
+               stats.rx_fifo_depth_max,
+               stats.tx_fifo_depth_max);
+  ::Focus.send(stats.link.spi.rearm_fast_count,
+               stats.link.spi.rearm_reset_count,
+               stats.link.spi.rearm_time_last_us,
+               stats.link.spi.rearm_time_max_us,
+               stats.link.spi.irq_time_max_us,
+               stats.link.spi.done_time_max_us);
+  ::Focus.sendRaw(F("\r\n"));
+}
+
+EventHandlerResult SpiLinkStats::onFocusEvent(const char *command) {
+  if (::Focus.handleHelp(command, PSTR("spi.stats\nspi.statsReset\nspi.queueRam")))
+    return EventHandlerResult::OK;
+
+  if (strncmp_P(command, PSTR("spi."), 4) != 0)
+    return EventHandlerResult::OK;
+
+  if (strcmp_P(command + 4, PSTR("stats")) == 0) {
+    for (uint8_t port : spi_ports) {
+      sendStats(port);
+    }
+  } else if (strcmp_P(command + 4, PSTR("queueRam")) == 0) {
+    // The storage of all the packet queues, in bytes
+    ::Focus.send(static_cast<uint32_t>(Spsc_fifo_buffer::get_ram_total()));
+  } else if (strcmp_P(command + 4, PSTR("statsReset")) == 0) {
+    for (uint8_t port : spi_ports) {
+      SpiPort(port).resetStats();
+    }
+  } else {
+    return EventHandlerResult::OK;
+  }
+
+  return EventHandlerResult::EVENT_CONSUMED;
+}
+
+}  // namespace plugin
+}  // namespace kaleidoscope
+
+kaleidoscope::plugin::SpiLinkStats SpiLinkStats;
@@ -21,7 +21,12 @@
 
 #include "hidDefy.h"
 
+#if HID_DEFY_SPLIT_INTERFACES
+const uint8_t hid_report_descriptor_defy[] = { HID_DEFY_KEYBOARD_REPORT_DESCRIPTOR };
+const uint8_t hid_report_descriptor_defy_pointer[] = { HID_DEFY_POINTER_REPORT_DESCRIPTOR };
+#else
 const uint8_t hid_report_descriptor_defy[] = HID_DEFY_REPORT_DESCRIPTOR( RAW_USAGE_DEFY );
+#endif
 
 void hid_report_descriptor_get( const uint8_t ** pp_desc, uint32_t * p_desc_len )
 {
@@ -29,6 +34,14 @@ void hid_report_descriptor_get( const uint8_t ** pp_desc, uint32_t * p_desc_len
     *p_desc_len = sizeof( hid_report_descriptor_defy );
 }
 
+#if HID_DEFY_SPLIT_INTERFACES
+void hid_report_descriptor_usb_pointer_get( const uint8_t ** pp_desc, uint32_t * p_desc_len )
+{
+    *pp_desc = &hid_report_descriptor_defy_pointer[0];
+    *p_desc_len = sizeof( hid_report_descriptor_defy_pointer );
+}
+#endif
+
 void hid_report_descriptor_usb_get( const uint8_t ** pp_desc, uint32_t * p_desc_len )
 {
     /* Get the valid descriptor */
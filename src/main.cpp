@@ -59,6 +59,8 @@
 #include "kaleidoscope/device/dygma/defyWN/universalModules/SettingsConfigurator.h"
 #include "Spi_slave.h"
 #include "IntegrationTest.h"
+#include "SpiLinkStats.h"
+#include "KeyLatencyStats.h"
 
 Watchdog_timer watchdog_timer;
 
@@ -209,6 +211,8 @@ KALEIDOSCOPE_INIT_PLUGINS(
   LayerFocus,
   EEPROMUpgrade,
   IntegrationTest,
+  SpiLinkStats,
+  KeyLatencyStats,
   HostPowerManagement);
 // clang-format on
 
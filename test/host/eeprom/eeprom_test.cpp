@@ -0,0 +1,658 @@
+/*
+ * Host tests of the EEPROM emulation on the simulated flash. The source is built once per storage variant, see
+ * test/host/CMakeLists.txt: the sector slots, the slots with EEPROM_XIP_READS, and EEPROM_JOURNAL.
+ *
+ *  - The settings of the EEPROM region are imported on the first boot and the region is left as it is.
+ *  - Random writes through every access path match a model, before and after the updates and the reboots.
+ *  - The reads through operator[] leave the image clean.
+ *  - erase() erases the storage and keeps the image, the next update saves all of it.
+ *  - A power cut at any flash operation of an update leaves the previous or the new image after the reboot. In the
+ *    journal every record is committed on its own, so there every byte is either the previous or the new one. This
+ *    holds for a put() over more pages than EEPROM_XIP_READS has page buffers too, the writes never touch the flash.
+ *  - The slots only rewrite the sectors which changed, the erases rotate over the spare slots, and the saved image
+ *    survives begin() with another size.
+ *  - The journal spreads its erases over all its sectors.
+ *  - No updateStep() or maintenance() call keeps the flash busy for more than an erase and a few page programs, the
+ *    journal compactions included. The commit latencies are printed.
+ */
+
+#include <random>
+
+#include "EEPROM.h"
+#include "flash_sim.h"
+#include "test_check.h"
+
+#define IMAGE_SIZE      8192
+
+/* The firmware EEPROM object lives forever, every simulated boot of the tests gets a new one */
+class Eeprom_boot : public EEPROMClass
+{
+    public:
+        explicit Eeprom_boot(size_t size = IMAGE_SIZE) { begin(size); }
+        ~Eeprom_boot() { delete[] _data; }
+
+#if EEPROM_JOURNAL
+        uint32_t journalGeneration() const { return _journal.getGeneration(); }
+#endif
+
+        void snapshot(uint8_t *image)
+        {
+            for (size_t i = 0; i < length(); i++) image[i] = read(i);
+        }
+
+        bool equals(const uint8_t *image)
+        {
+            for (size_t i = 0; i < length(); i++)
+            {
+                if (read(i) != image[i]) return false;
+            }
+            return true;
+        }
+};
+
+static void legacy_fill(uint8_t *model)
+{
+    for (int i = 0; i < IMAGE_SIZE; i++)
+    {
+        model[i] = (uint8_t)(i * 11 + 3);
+    }
+    memcpy(flash_sim_sector(FLASH_SIM_EEPROM_SECTOR), model, IMAGE_SIZE);
+}
+
+/* Changes a few bytes through one of the access paths, the model follows */
+static void random_change(Eeprom_boot &eeprom, uint8_t *model, std::mt19937 &random)
+{
+    int address = random() % IMAGE_SIZE;
+
+    switch (random() % 6)
+    {
+        case 0:
+        {
+            uint8_t value = random();
+            eeprom.write(address, value);
+            model[address] = value;
+            break;
+        }
+
+        case 1:
+        {
+            uint32_t value = random();
+            address = std::min(address, IMAGE_SIZE - (int)sizeof(value));
+            eeprom.put(address, value);
+            memcpy(model + address, &value, sizeof(value));
+            break;
+        }
+
+        case 2:
+        {
+            uint8_t value = random();
+            eeprom[address] = value;
+            model[address] = value;
+            break;
+        }
+
+        case 3:
+        {
+            /* A keymap sized chunk, sometimes over a page or a sector edge */
+            uint8_t chunk[300];
+            int len = 1 + random() % sizeof(chunk);
+            address = std::min(address, IMAGE_SIZE - len);
+            for (int i = 0; i < len; i++) chunk[i] = random();
+            for (int i = 0; i < len; i++) eeprom.write(address + i, chunk[i]);
+            memcpy(model + address, chunk, len);
+            break;
+        }
+
+        case 4:
+        {
+            /* Blank pages are not programmed */
+            int len = 1 + random() % 600;
+            address = std::min(address, IMAGE_SIZE - len);
+            for (int i = 0; i < len; i++) eeprom.write(address + i, 0xFF);
+            memset(model + address, 0xFF, len);
+            break;
+        }
+
+        default:
+        {
+            uint32_t value;
+            address = std::min(address, IMAGE_SIZE - (int)sizeof(value));
+            eeprom.get(address, value);
+            CHECK(memcmp(&value, model + address, sizeof(value)) == 0);
+            break;
+        }
+    }
+}
+
+static void test_import(void)
+{
+    static uint8_t model[IMAGE_SIZE];
+
+    flash_sim_reset();
+    legacy_fill(model);
+
+    {
+        Eeprom_boot eeprom;
+        CHECK(eeprom.equals(model));
+        eeprom.update();
+    }
+
+    Eeprom_boot eeprom;
+    CHECK(eeprom.equals(model));
+    CHECK(!eeprom.getNeedUpdate());
+    CHECK(memcmp(flash_sim_sector(FLASH_SIM_EEPROM_SECTOR), model, IMAGE_SIZE) == 0);
+}
+
+static void test_random(uint32_t seed)
+{
+    static uint8_t model[IMAGE_SIZE];
+    std::mt19937 random(seed);
+    Eeprom_boot *p_eeprom;
+
+    flash_sim_reset();
+    legacy_fill(model);
+    p_eeprom = new Eeprom_boot;
+
+    for (int step = 0; step < 100000; step++)
+    {
+        random_change(*p_eeprom, model, random);
+
+        if (random() % 200 == 0)
+        {
+            p_eeprom->commit();
+            p_eeprom->update();
+        }
+        if (random() % 10 == 0)
+        {
+            p_eeprom->maintenance();
+        }
+        if (random() % 5000 == 0)
+        {
+            CHECK(p_eeprom->equals(model));
+
+            p_eeprom->commit();
+            p_eeprom->update();
+            delete p_eeprom;
+            p_eeprom = new Eeprom_boot;
+            CHECK(p_eeprom->equals(model));
+        }
+    }
+
+    /* The RAM copy of getDataPtr() */
+    uint8_t *p_data = p_eeprom->getDataPtr();
+    CHECK(memcmp(p_data, model, IMAGE_SIZE) == 0);
+    p_data[9] = 0x42;
+    model[9] = 0x42;
+    p_eeprom->write(5, model[5] ^ 1);
+    model[5] ^= 1;
+    CHECK(memcmp(p_eeprom->getConstDataPtr(), model, IMAGE_SIZE) == 0);
+
+    p_eeprom->commit();
+    p_eeprom->update();
+    delete p_eeprom;
+
+    Eeprom_boot eeprom;
+    CHECK(eeprom.equals(model));
+}
+
+static void test_power_cut(uint32_t seed)
+{
+    static uint8_t committed[IMAGE_SIZE];
+    static uint8_t target[IMAGE_SIZE];
+    static uint8_t image[IMAGE_SIZE];
+    std::mt19937 random(seed);
+    Eeprom_boot *p_eeprom;
+    int cuts = 0;
+
+    flash_sim_reset();
+    legacy_fill(committed);
+    p_eeprom = new Eeprom_boot;
+    p_eeprom->update();
+
+    for (int round = 0; round < 3000; round++)
+    {
+        bool cut = false;
+        uint32_t programs = flash_sim_stats.programs;
+
+        memcpy(target, committed, IMAGE_SIZE);
+        for (int i = 1 + random() % 8; i > 0; i--)
+        {
+            random_change(*p_eeprom, target, random);
+        }
+        p_eeprom->commit();
+
+        /* The writes never wait for the flash, also with EEPROM_XIP_READS when they need more than the page buffers */
+        CHECK_EQ(flash_sim_stats.programs, programs);
+
+        /* Half the updates are cut, mostly early as the journal commits take a few flash operations only */
+        flash_sim_power_cut_arm((random() % 2) ? random() % (1 + random() % 40) : -1);
+        try
+        {
+            p_eeprom->update();
+            if (random() % 2) p_eeprom->maintenance();
+        }
+        catch (Flash_sim_power_cut &)
+        {
+            cut = true;
+            cuts++;
+        }
+        flash_sim_power_cut_arm(-1);
+
+        delete p_eeprom;
+        p_eeprom = new Eeprom_boot;
+        p_eeprom->snapshot(image);
+
+        if (!cut)
+        {
+            CHECK(memcmp(image, target, IMAGE_SIZE) == 0);
+        }
+        else
+        {
+#if EEPROM_JOURNAL
+            bool torn = false;
+            for (int i = 0; i < IMAGE_SIZE; i++)
+            {
+                if (image[i] != committed[i] && image[i] != target[i]) torn = true;
+            }
+            CHECK(!torn);
+#else
+            CHECK(memcmp(image, committed, IMAGE_SIZE) == 0 || memcmp(image, target, IMAGE_SIZE) == 0);
+#endif
+        }
+        CHECK(!p_eeprom->getNeedUpdate());
+
+        if (test_failures != 0)
+        {
+            printf("power cut: failed in the round %d\n", round);
+            break;
+        }
+        memcpy(committed, image, IMAGE_SIZE);
+    }
+
+    delete p_eeprom;
+    printf("power cut: %d of %d updates cut\n", cuts, 3000);
+}
+
+#if !EEPROM_JOURNAL
+/* An update rewrites only the sectors that changed, into the spare slots in turn */
+static void test_erase_count(void)
+{
+    const int updates = 2048;
+    uint8_t value;
+
+    flash_sim_reset();
+
+    Eeprom_boot eeprom;
+    for (int i = 0; i < IMAGE_SIZE; i++) eeprom.write(i, (uint8_t)i);
+    eeprom.commit();
+    eeprom.update();
+
+    /* Nothing changed, nothing written */
+    flash_sim_stats_reset();
+    eeprom.write(10, eeprom.read(10));
+    eeprom.commit();
+    CHECK(!eeprom.getNeedUpdate());
+    eeprom.update();
+    CHECK_EQ(flash_sim_stats.erases + flash_sim_stats.programs, 0);
+
+    /* One sector changed: its slot, 16 pages and the record, the record sector erased every 128 records */
+    flash_sim_stats_reset();
+    for (int t = 0; t < updates; t++)
+    {
+        uint32_t erases = flash_sim_stats.erases;
+        uint32_t programs = flash_sim_stats.programs;
+        int address = (t % 2) * EEPROM_SECTOR_SIZE + (t * 37) % EEPROM_SECTOR_SIZE;
+
+        value = eeprom.read(address) ^ 1;
+        eeprom.write(address, value);
+        eeprom.commit();
+        eeprom.update();
+
+        CHECK(flash_sim_stats.erases - erases == 1 || flash_sim_stats.erases - erases == 2);
+        CHECK_EQ(flash_sim_stats.programs - programs, EEPROM_SECTOR_SIZE / EEPROM_PAGE_SIZE + 1);
+    }
+    CHECK_EQ(flash_sim_stats.erases, updates + updates / EEPROM_RECORDS_PER_SECTOR);
+
+    /* Both sectors changed */
+    flash_sim_stats_reset();
+    for (int t = 0; t < updates; t++)
+    {
+        eeprom.write(t % EEPROM_SECTOR_SIZE, eeprom.read(t % EEPROM_SECTOR_SIZE) ^ 1);
+        eeprom.write(EEPROM_SECTOR_SIZE + t % EEPROM_SECTOR_SIZE, eeprom.read(EEPROM_SECTOR_SIZE + t % EEPROM_SECTOR_SIZE) ^ 1);
+        eeprom.commit();
+        eeprom.update();
+    }
+    CHECK_EQ(flash_sim_stats.erases, 2 * updates + updates / EEPROM_RECORDS_PER_SECTOR);
+
+    /* The slot erases are spread evenly, the EEPROM region and the journal sectors are never erased */
+    uint32_t slot_min = UINT32_MAX;
+    uint32_t slot_max = 0;
+    for (int slot = 0; slot < EEPROM_SLOTS_COUNT; slot++)
+    {
+        slot_min = std::min(slot_min, flash_sim_stats.sector_erases[FLASH_SIM_SLOTS_SECTOR + slot]);
+        slot_max = std::max(slot_max, flash_sim_stats.sector_erases[FLASH_SIM_SLOTS_SECTOR + slot]);
+    }
+    CHECK(slot_max - slot_min <= 2);
+    for (int sector = 0; sector < FLASH_SIM_SECTORS; sector++)
+    {
+        if (sector < FLASH_SIM_SLOTS_SECTOR || sector >= FLASH_SIM_EEPROM_SECTOR)
+        {
+            CHECK_EQ(flash_sim_stats.sector_erases[sector], 0);
+        }
+    }
+}
+
+/* begin() with another size keeps what fits of the saved image */
+static void test_size_change(void)
+{
+    flash_sim_reset();
+
+    {
+        Eeprom_boot eeprom;
+        for (int i = 0; i < IMAGE_SIZE; i++) eeprom.write(i, (uint8_t)(i * 3 + 1));
+        eeprom.commit();
+        eeprom.update();
+    }
+    {
+        Eeprom_boot eeprom(IMAGE_SIZE / 2);
+        bool kept = true;
+        for (int i = 0; i < IMAGE_SIZE / 2; i++) kept &= eeprom.read(i) == (uint8_t)(i * 3 + 1);
+        CHECK(kept);
+        eeprom.update();
+    }
+    {
+        Eeprom_boot eeprom(IMAGE_SIZE / 2);
+        CHECK(!eeprom.getNeedUpdate());
+    }
+    {
+        /* The half past the saved size comes back erased */
+        Eeprom_boot eeprom;
+        bool kept = true;
+        CHECK(eeprom.getNeedUpdate());
+        for (int i = 0; i < IMAGE_SIZE / 2; i++) kept &= eeprom.read(i) == (uint8_t)(i * 3 + 1);
+        for (int i = IMAGE_SIZE / 2; i < IMAGE_SIZE; i++) kept &= eeprom.read(i) == 0xFF;
+        CHECK(kept);
+        eeprom.write(5000, 7);
+        eeprom.commit();
+        eeprom.update();
+    }
+    {
+        Eeprom_boot eeprom;
+        CHECK(!eeprom.getNeedUpdate());
+        CHECK_EQ(eeprom.read(100), (uint8_t)(100 * 3 + 1));
+        CHECK_EQ(eeprom.read(5000), 7);
+    }
+}
+#else
+/* The commits only program pages, the compactions erase the journal sectors in turn */
+static void test_wear(void)
+{
+    static uint8_t model[IMAGE_SIZE];
+    std::mt19937 random(5);
+    const int updates = 20000;
+
+    flash_sim_reset();
+    legacy_fill(model);
+
+    Eeprom_boot eeprom;
+    flash_sim_stats_reset();
+
+    for (int t = 0; t < updates; t++)
+    {
+        random_change(eeprom, model, random);
+        eeprom.commit();
+        eeprom.update();
+        if (t % 3 == 0) eeprom.maintenance();
+    }
+    CHECK(eeprom.equals(model));
+
+    uint32_t sector_min = UINT32_MAX;
+    uint32_t sector_max = 0;
+    for (int sector = 0; sector < EEPROM_JOURNAL_SECTORS; sector++)
+    {
+        sector_min = std::min(sector_min, flash_sim_stats.sector_erases[FLASH_SIM_JOURNAL_SECTOR + sector]);
+        sector_max = std::max(sector_max, flash_sim_stats.sector_erases[FLASH_SIM_JOURNAL_SECTOR + sector]);
+    }
+    CHECK(sector_min > 0);
+    CHECK(sector_max <= 2 * sector_min);
+    CHECK(flash_sim_stats.erases < (uint32_t)updates / 10);
+    for (int sector = FLASH_SIM_SLOTS_SECTOR; sector < FLASH_SIM_SECTORS; sector++)
+    {
+        CHECK_EQ(flash_sim_stats.sector_erases[sector], 0);
+    }
+
+    printf("wear: %d updates, %u erases over the journal sectors (%u to %u each), %.2f page programs per update\n",
+           updates, flash_sim_stats.erases, sector_min, sector_max, (double)flash_sim_stats.programs / updates);
+}
+#endif
+
+/* erase() erases the storage and keeps the image, the next update saves it whole. Alike in every storage variant. */
+static void test_erase(void)
+{
+    static uint8_t model[IMAGE_SIZE];
+    static uint8_t blank[IMAGE_SIZE];
+    Eeprom_boot *p_eeprom;
+
+    flash_sim_reset();
+    legacy_fill(model);
+    memset(blank, 0xFF, IMAGE_SIZE);
+    p_eeprom = new Eeprom_boot;
+    p_eeprom->update();
+
+    p_eeprom->erase();
+    CHECK(p_eeprom->equals(model));
+
+    /* Only one page changed, the update saves the whole image kept by erase() */
+    p_eeprom->write(100, 0x5A);
+    model[100] = 0x5A;
+    p_eeprom->commit();
+    p_eeprom->update();
+
+    delete p_eeprom;
+    p_eeprom = new Eeprom_boot;
+    CHECK(p_eeprom->equals(model));
+
+    /* Nothing saved after the erase */
+    p_eeprom->erase();
+    delete p_eeprom;
+    p_eeprom = new Eeprom_boot;
+    CHECK(p_eeprom->equals(blank));
+    delete p_eeprom;
+}
+
+/* The commits run the way EEPROMUpgrade drives them, one updateStep() or maintenance() per loop cycle */
+static void test_latency(void)
+{
+    static uint8_t model[IMAGE_SIZE];
+    std::mt19937 random(6);
+    const int commits = 3000;
+    uint64_t step_max_us = 0;
+    uint32_t step_erases_max = 0;
+    uint32_t step_programs_max = 0;
+    uint64_t commit_max_us = 0;
+    uint64_t commit_total_us = 0;
+    int compactions = 0;
+
+    flash_sim_reset();
+    legacy_fill(model);
+
+    Eeprom_boot eeprom;
+    eeprom.update();
+
+    for (int t = 0; t < commits; t++)
+    {
+        uint64_t const commit_start_us = flash_sim_stats.busy_us;
+
+        for (int i = 1 + random() % 4; i > 0; i--)
+        {
+            random_change(eeprom, model, random);
+        }
+        eeprom.commit();
+
+        for (bool more = true; more;)
+        {
+            Flash_sim_stats const step_start = flash_sim_stats;
+            more = eeprom.updateStep();
+            step_max_us = std::max(step_max_us, flash_sim_stats.busy_us - step_start.busy_us);
+            step_erases_max = std::max(step_erases_max, flash_sim_stats.erases - step_start.erases);
+            step_programs_max = std::max(step_programs_max, flash_sim_stats.programs - step_start.programs);
+        }
+        commit_max_us = std::max(commit_max_us, flash_sim_stats.busy_us - commit_start_us);
+        commit_total_us += flash_sim_stats.busy_us - commit_start_us;
+
+        /* The idle cycles in between */
+        for (int i = random() % 3; i > 0; i--)
+        {
+            Flash_sim_stats const step_start = flash_sim_stats;
+#if EEPROM_JOURNAL
+            uint32_t const generation = eeprom.journalGeneration();
+#endif
+            eeprom.maintenance();
+            step_max_us = std::max(step_max_us, flash_sim_stats.busy_us - step_start.busy_us);
+            step_erases_max = std::max(step_erases_max, flash_sim_stats.erases - step_start.erases);
+            step_programs_max = std::max(step_programs_max, flash_sim_stats.programs - step_start.programs);
+#if EEPROM_JOURNAL
+            compactions += eeprom.journalGeneration() != generation;
+#endif
+        }
+    }
+    CHECK(eeprom.equals(model));
+    CHECK(step_erases_max <= 1);
+    CHECK(step_programs_max <= 3);
+#if EEPROM_JOURNAL
+    CHECK(compactions > 0);
+#endif
+
+    printf("latency: %d commits, %.1f ms per commit on average, %.1f ms at most, %.1f ms the longest step, %d compactions\n",
+           commits, commit_total_us / 1000.0 / commits, commit_max_us / 1000.0, step_max_us / 1000.0, compactions);
+}
+
+/* Reading through operator[] leaves the pages clean and takes no page buffer, only an assignment changes the page */
+static void test_subscript(void)
+{
+    uint8_t model[IMAGE_SIZE];
+    uint32_t programs;
+    uint32_t sum = 0;
+
+    flash_sim_reset();
+    legacy_fill(model);
+    Eeprom_boot eeprom;
+    eeprom.update();
+    programs = flash_sim_stats.programs;
+
+    for (int address = 0; address < IMAGE_SIZE; address += 100)
+    {
+        CHECK_EQ(eeprom[address], model[address]);
+        sum += eeprom[address];
+    }
+    eeprom.commit();
+    CHECK(!eeprom.getNeedUpdate());
+    CHECK_EQ(flash_sim_stats.programs, programs);
+    CHECK(sum != 0);
+
+    eeprom[300] = (uint8_t)~model[300];
+    eeprom[301] |= 0x81;
+    model[300] = (uint8_t)~model[300];
+    model[301] |= 0x81;
+    eeprom.commit();
+    CHECK(eeprom.getNeedUpdate());
+    eeprom.update();
+    CHECK(eeprom.equals(model));
+}
+
+/* A put() over more pages than EEPROM_XIP_READS has page buffers is saved as a whole, or not at all */
+static void test_put_large(uint32_t seed)
+{
+    static uint8_t committed[IMAGE_SIZE];
+    static uint8_t target[IMAGE_SIZE];
+    static uint8_t image[IMAGE_SIZE];
+    struct
+    {
+        uint8_t bytes[EEPROM_PAGE_SIZE * (EEPROM_OVERLAY_PAGES + 2)];
+    } value;
+    std::mt19937 random(seed);
+    Eeprom_boot *p_eeprom;
+    int cuts = 0;
+
+    flash_sim_reset();
+    legacy_fill(committed);
+    p_eeprom = new Eeprom_boot;
+    p_eeprom->update();
+
+    for (int round = 0; round < 200; round++)
+    {
+        uint32_t programs = flash_sim_stats.programs;
+        int address = random() % (IMAGE_SIZE - (int)sizeof(value));
+        bool cut = false;
+
+        for (size_t i = 0; i < sizeof(value); i++) value.bytes[i] = random();
+        memcpy(target, committed, IMAGE_SIZE);
+        memcpy(target + address, &value, sizeof(value));
+        p_eeprom->put(address, value);
+        p_eeprom->commit();
+        CHECK_EQ(flash_sim_stats.programs, programs);
+        CHECK(p_eeprom->equals(target));
+
+        flash_sim_power_cut_arm((random() % 4) ? random() % 16 : -1);
+        try
+        {
+            p_eeprom->update();
+        }
+        catch (Flash_sim_power_cut &)
+        {
+            cut = true;
+            cuts++;
+        }
+        flash_sim_power_cut_arm(-1);
+
+        delete p_eeprom;
+        p_eeprom = new Eeprom_boot;
+        p_eeprom->snapshot(image);
+
+        if (!cut)
+        {
+            CHECK(memcmp(image, target, IMAGE_SIZE) == 0);
+        }
+        else
+        {
+#if EEPROM_JOURNAL
+            /* Every record is committed on its own */
+            for (int i = 0; i < IMAGE_SIZE; i++)
+            {
+                CHECK(image[i] == committed[i] || image[i] == target[i]);
+            }
+#else
+            CHECK(memcmp(image, committed, IMAGE_SIZE) == 0 || memcmp(image, target, IMAGE_SIZE) == 0);
+#endif
+        }
+        if (test_failures != 0)
+        {
+            printf("put large: failed in the round %d\n", round);
+            break;
+        }
+        memcpy(committed, image, IMAGE_SIZE);
+    }
+
+    delete p_eeprom;
+    printf("put large: %d of 200 updates cut\n", cuts);
+}
+
+int main(void)
+{
+    test_import();
+    test_subscript();
+    test_random(1);
+    test_random(2);
+    test_power_cut(3);
+    test_put_large(4);
+    test_erase();
+    test_latency();
+#if !EEPROM_JOURNAL
+    test_erase_count();
+    test_size_change();
+#else
+    test_wear();
+#endif
+
+    return test_result();
+}
@@ -0,0 +1,121 @@
+/*
+ * Simulated flash of the EEPROM host tests, see flash_sim.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Arduino.h"
+#include "flash_sim.h"
+#include "host_time.h"
+#include "hardware/flash.h"
+
+extern "C" {
+__attribute__((aligned(FLASH_SIM_SECTOR_SIZE))) uint8_t flash_sim_region[FLASH_SIM_SECTORS * FLASH_SIM_SECTOR_SIZE];
+}
+
+Flash_sim_stats flash_sim_stats;
+
+static long power_cut_countdown = -1;
+static uint32_t power_cut_seed = 1;
+
+void flash_sim_reset(void)
+{
+    memset(flash_sim_region, 0xFF, sizeof(flash_sim_region));
+    flash_sim_stats_reset();
+    power_cut_countdown = -1;
+}
+
+void flash_sim_stats_reset(void)
+{
+    memset(&flash_sim_stats, 0x00, sizeof(flash_sim_stats));
+}
+
+void flash_sim_power_cut_arm(long operations)
+{
+    power_cut_countdown = operations;
+}
+
+/* The flash under the offset, a misaligned or misplaced operation is a bug of the code under test */
+static uint8_t *flash_sim_get(intptr_t flash_offs, size_t count, size_t unit)
+{
+    uint8_t *p_flash = (uint8_t *)(flash_offs + (intptr_t)XIP_BASE);
+
+    if (p_flash < flash_sim_region || p_flash + count > flash_sim_region + sizeof(flash_sim_region) ||
+        (p_flash - flash_sim_region) % unit != 0 || count != unit)
+    {
+        printf("flash_sim: bad operation of %zu bytes at offset %td of the simulated flash\n", count,
+               p_flash - flash_sim_region);
+        abort();
+    }
+
+    return p_flash;
+}
+
+static void flash_sim_busy(uint32_t time_us)
+{
+    flash_sim_stats.busy_us += time_us;
+    host_time_us_set(host_time_us_get() + time_us);
+}
+
+/* The number of bytes the operation gets done with before the power goes, all of them if it stays */
+static size_t flash_sim_power_check(size_t count)
+{
+    if (power_cut_countdown < 0)
+    {
+        return count;
+    }
+    if (power_cut_countdown-- > 0)
+    {
+        return count;
+    }
+
+    /* xorshift32 */
+    power_cut_seed ^= power_cut_seed << 13;
+    power_cut_seed ^= power_cut_seed >> 17;
+    power_cut_seed ^= power_cut_seed << 5;
+
+    return power_cut_seed % count;
+}
+
+void flash_range_erase(intptr_t flash_offs, size_t count)
+{
+    uint8_t *p_flash = flash_sim_get(flash_offs, count, FLASH_SIM_SECTOR_SIZE);
+    size_t done = flash_sim_power_check(count);
+
+    memset(p_flash, 0xFF, done);
+    if (done < count)
+    {
+        throw Flash_sim_power_cut();
+    }
+
+    flash_sim_stats.erases++;
+    flash_sim_stats.sector_erases[(p_flash - flash_sim_region) / FLASH_SIM_SECTOR_SIZE]++;
+    flash_sim_busy(FLASH_SIM_ERASE_US);
+}
+
+void flash_range_program(intptr_t flash_offs, const uint8_t *data, size_t count)
+{
+    uint8_t *p_flash = flash_sim_get(flash_offs, count, FLASH_SIM_PAGE_SIZE);
+    size_t done = flash_sim_power_check(count);
+
+    /* The data can't come from the flash itself, the XIP reads are off while programming */
+    if (data >= flash_sim_region && data < flash_sim_region + sizeof(flash_sim_region))
+    {
+        printf("flash_sim: program from the flash at offset %td\n", data - flash_sim_region);
+        abort();
+    }
+
+    for (size_t i = 0; i < done; i++)
+    {
+        p_flash[i] &= data[i];
+    }
+    if (done < count)
+    {
+        throw Flash_sim_power_cut();
+    }
+
+    flash_sim_stats.programs++;
+    flash_sim_busy(FLASH_SIM_PROGRAM_US);
+}
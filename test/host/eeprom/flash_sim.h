@@ -0,0 +1,58 @@
+/*
+ * Simulated flash of the EEPROM host tests. It has the layout of memmap_mainProgram.ld: the journal, the sector slots
+ * with the commit records, and the EEPROM region the settings of the older firmware are imported from. The linker
+ * places the _EEPROM_* symbols into it, see test/host/CMakeLists.txt.
+ *
+ * Like the real flash, an erase sets a whole sector to 0xFF and a program can only clear bits of a whole page. Every
+ * operation is counted per sector, and a power cut can be armed: the chosen operation is only done in part, then the
+ * Flash_sim_power_cut exception unwinds the code under test as if the MCU had lost power.
+ *
+ * The operations take the typical times of the W25Q16JV flash of the board. They move the simulated time forward and
+ * add up in busy_us, so the tests measure how long a commit keeps the firmware from running.
+ */
+
+#ifndef __FLASH_SIM_H__
+#define __FLASH_SIM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLASH_SIM_SECTOR_SIZE       4096
+#define FLASH_SIM_PAGE_SIZE         256
+
+#define FLASH_SIM_JOURNAL_SECTOR    0
+#define FLASH_SIM_SLOTS_SECTOR      16
+#define FLASH_SIM_EEPROM_SECTOR     22
+#define FLASH_SIM_SECTORS           24
+
+#define FLASH_SIM_ERASE_US          45000   // Sector erase
+#define FLASH_SIM_PROGRAM_US        400     // Page program
+
+extern "C" uint8_t flash_sim_region[FLASH_SIM_SECTORS * FLASH_SIM_SECTOR_SIZE];
+
+struct Flash_sim_stats
+{
+    uint32_t erases;
+    uint32_t programs;
+    uint32_t sector_erases[FLASH_SIM_SECTORS];
+    uint64_t busy_us;       // Time spent in the flash operations
+};
+
+struct Flash_sim_power_cut
+{
+};
+
+extern Flash_sim_stats flash_sim_stats;
+
+void flash_sim_reset(void);                         // All the flash erased, the counters cleared
+void flash_sim_stats_reset(void);
+
+// The power is cut during the flash operation after the next operations ones, a negative count disarms the cut
+void flash_sim_power_cut_arm(long operations);
+
+static inline uint8_t *flash_sim_sector(int sector)
+{
+    return flash_sim_region + sector * FLASH_SIM_SECTOR_SIZE;
+}
+
+#endif  // __FLASH_SIM_H__
@@ -0,0 +1,146 @@
+/*
+ * Host benchmark of the FIFO calls. A put() and a get() are timed at a steady fill level, for the Fifo_buffer ring and
+ * for the former Fifo_buffer, which moved all the items one place forward on every get(). The ring must cost the same
+ * at every fill level and with every capacity, the shifting FIFO is printed for the comparison.
+ */
+
+#include <algorithm>
+#include <chrono>
+
+#include "Fifo.h"
+#include "Fifo_buffer.h"
+#include "test_check.h"
+
+struct Packet
+{
+    uint8_t buf[32];
+};
+
+/* The former Fifo_buffer, as it was before the ring */
+class Fifo_buffer_shifting
+{
+    public:
+        explicit Fifo_buffer_shifting(size_t _item_size) : item_size(_item_size)
+        {
+            memset(internal_buffer, 0, sizeof(internal_buffer));
+        }
+
+        bool put(const void *item)
+        {
+            if (index + item_size > INTERNAL_BUFFER_SIZE) return false;
+
+            memcpy(internal_buffer + index, item, item_size);
+            index += item_size;
+            num_items++;
+            return true;
+        }
+
+        size_t get(void *item)
+        {
+            memset(item, 0, item_size);
+            if (index == 0) return 0;
+
+            memcpy(item, internal_buffer, item_size);
+            size_t count = 0;
+            for (size_t i = 0; i + 1 < num_items; i++)
+            {
+                for (size_t j = 0; j < item_size; j++)
+                {
+                    internal_buffer[count] = internal_buffer[item_size + count];
+                    count++;
+                }
+            }
+            memset(&internal_buffer[count], 0, item_size);
+            index -= item_size;
+            num_items--;
+            return item_size;
+        }
+
+    private:
+        size_t item_size;
+        uint8_t internal_buffer[INTERNAL_BUFFER_SIZE];
+        size_t index = 0;
+        size_t num_items = 0;
+};
+
+/* Nanoseconds per put() and get() pair with the FIFO holding fill items, the best of a few runs */
+template <typename F>
+static double pair_ns(F &fifo, size_t fill)
+{
+    const int pairs = 20000;
+    Packet packet = {};
+    double best = 1e30;
+    uint32_t sum = 0;
+
+    for (size_t i = 0; i < fill; i++) fifo.put(&packet);
+
+    for (int run = 0; run < 5; run++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < pairs; i++)
+        {
+            packet.buf[0] = (uint8_t)i;
+            fifo.put(&packet);
+            fifo.get(&packet);
+            sum += packet.buf[0];
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / pairs);
+    }
+
+    while (fill-- > 0) fifo.get(&packet);
+
+    /* The items really went through */
+    CHECK(sum != 0);
+    return best;
+}
+
+static void test_fill_levels(void)
+{
+    const size_t capacity = INTERNAL_BUFFER_SIZE / sizeof(Packet);
+    const int percents[] = { 0, 25, 50, 75, 99 };
+    double ring_min = 1e30;
+    double ring_max = 0;
+
+    printf("fill level   Fifo_buffer ring   shifting Fifo_buffer   (ns per put and get, %zu packets of %zu bytes)\n",
+           capacity, sizeof(Packet));
+    for (int percent : percents)
+    {
+        size_t const fill = (capacity - 1) * percent / 100;
+        Fifo_buffer ring(sizeof(Packet));
+        Fifo_buffer_shifting shifting(sizeof(Packet));
+
+        double const ring_ns = pair_ns(ring, fill);
+        double const shifting_ns = pair_ns(shifting, fill);
+
+        ring_min = std::min(ring_min, ring_ns);
+        ring_max = std::max(ring_max, ring_ns);
+        printf("%9d%%   %16.1f   %20.1f\n", percent, ring_ns, shifting_ns);
+    }
+
+    /* Flat, with room for the timing noise of the machine */
+    CHECK(ring_max < 3 * ring_min);
+}
+
+static void test_capacities(void)
+{
+    static Fifo<Packet, 16> fifo_16;
+    static Fifo<Packet, 93> fifo_93;
+    static Fifo<Packet, 1024> fifo_1024;
+    double const ns_16 = pair_ns(fifo_16, 15);
+    double const ns_93 = pair_ns(fifo_93, 92);
+    double const ns_1024 = pair_ns(fifo_1024, 1023);
+
+    printf("Fifo<Packet, N> full but one: N = 16 %.1f ns, N = 93 %.1f ns, N = 1024 %.1f ns per put and get\n", ns_16,
+           ns_93, ns_1024);
+
+    CHECK(std::max({ ns_16, ns_93, ns_1024 }) < 3 * std::min({ ns_16, ns_93, ns_1024 }));
+}
+
+int main(void)
+{
+    test_fill_levels();
+    test_capacities();
+
+    return test_result();
+}
@@ -0,0 +1,311 @@
+/*
+ * Host tests of the SPSC FIFO: the single item and batch calls against a std::deque model, the wrap-around of the
+ * positions, both clears, and a producer and a consumer thread streaming through a small FIFO.
+ */
+
+#include <atomic>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Fifo.h"
+#include "test_check.h"
+
+struct Item
+{
+    uint32_t seq;
+    uint8_t payload[7];
+};
+
+static Item item_make(uint32_t seq)
+{
+    Item item;
+
+    item.seq = seq;
+    for (uint8_t i = 0; i < sizeof(item.payload); i++)
+    {
+        item.payload[i] = (uint8_t)(seq + i);
+    }
+
+    return item;
+}
+
+static bool item_valid(const Item &item, uint32_t seq)
+{
+    return item.seq == seq && item.payload[0] == (uint8_t)seq && item.payload[6] == (uint8_t)(seq + 6);
+}
+
+static void test_single(void)
+{
+    Fifo<Item, 3> fifo;
+    Item item;
+    uint32_t put_seq = 0;
+    uint32_t get_seq = 0;
+
+    CHECK(fifo.is_empty());
+    CHECK_EQ(fifo.get(&item), 0);
+    CHECK_EQ(fifo.peek(&item), 0);
+    CHECK_EQ(fifo.removeOne(), 0);
+
+    /* Many rounds, so the positions run over twice the capacity several times */
+    for (int round = 0; round < 20; round++)
+    {
+        while (!fifo.is_full())
+        {
+            item = item_make(put_seq++);
+            CHECK(fifo.put(&item));
+        }
+        CHECK_EQ(fifo.get_num_items(), 3);
+        CHECK(!fifo.put(&item));
+
+        CHECK_EQ(fifo.peek(&item), sizeof(Item));
+        CHECK(item_valid(item, get_seq));
+        CHECK_EQ(fifo.get_num_items(), 3);
+
+        /* Leave one item behind, so the next round starts off the storage start */
+        while (fifo.get_num_items() > 1)
+        {
+            CHECK_EQ(fifo.get(&item), sizeof(Item));
+            CHECK(item_valid(item, get_seq++));
+        }
+    }
+
+    CHECK_EQ(fifo.removeOne(), sizeof(Item));
+    CHECK(fifo.is_empty());
+}
+
+static void test_batch(void)
+{
+    Fifo<Item, 5> fifo;
+    Item items[8];
+    Item *p_span;
+
+    for (uint32_t i = 0; i < 8; i++) items[i] = item_make(i);
+
+    /* Only what fits goes in */
+    CHECK_EQ(fifo.put_n(items, 8), 5);
+    CHECK(fifo.is_full());
+    CHECK_EQ(fifo.put_n(items, 1), 0);
+
+    CHECK_EQ(fifo.remove_n(3), 3);
+    CHECK_EQ(fifo.put_n(items + 5, 3), 3);
+
+    /* The items 3 to 7 wrap around the storage end, the span stops there */
+    CHECK_EQ(fifo.peek_span(&p_span), 2);
+    CHECK(item_valid(p_span[0], 3));
+    CHECK(item_valid(p_span[1], 4));
+
+    Item out[8];
+    CHECK_EQ(fifo.get_n(out, 8), 5);
+    for (uint32_t i = 0; i < 5; i++) CHECK(item_valid(out[i], 3 + i));
+
+    CHECK_EQ(fifo.get_n(out, 8), 0);
+    CHECK_EQ(fifo.remove_n(1), 0);
+    CHECK_EQ(fifo.peek_span(&p_span), 0);
+}
+
+template <size_t N>
+static void test_model(uint32_t seed)
+{
+    Fifo<Item, N> fifo;
+    std::deque<Item> model;
+    std::mt19937 random(seed);
+    uint32_t seq = 0;
+    Item items[2 * N + 1];
+    Item *p_span;
+
+    for (int op = 0; op < 20000; op++)
+    {
+        size_t count = random() % (2 * N + 1);
+        size_t moved;
+
+        switch (random() % 7)
+        {
+            case 0:
+                items[0] = item_make(seq);
+                CHECK_EQ(fifo.put(items), model.size() < N);
+                if (model.size() < N) model.push_back(item_make(seq++));
+                break;
+
+            case 1:
+                for (size_t i = 0; i < count; i++) items[i] = item_make(seq + i);
+                moved = fifo.put_n(items, count);
+                CHECK_EQ(moved, std::min(count, N - model.size()));
+                for (size_t i = 0; i < moved; i++) model.push_back(item_make(seq++));
+                break;
+
+            case 2:
+                CHECK_EQ(fifo.get(items), model.empty() ? 0 : sizeof(Item));
+                if (!model.empty())
+                {
+                    CHECK(item_valid(items[0], model.front().seq));
+                    model.pop_front();
+                }
+                break;
+
+            case 3:
+                moved = fifo.get_n(items, count);
+                CHECK_EQ(moved, std::min(count, model.size()));
+                for (size_t i = 0; i < moved; i++)
+                {
+                    CHECK(item_valid(items[i], model.front().seq));
+                    model.pop_front();
+                }
+                break;
+
+            case 4:
+                moved = fifo.peek_span(&p_span);
+                CHECK(moved <= model.size());
+                CHECK(model.empty() || moved > 0);
+                for (size_t i = 0; i < moved; i++) CHECK(item_valid(p_span[i], model[i].seq));
+                break;
+
+            case 5:
+                moved = fifo.remove_n(count);
+                CHECK_EQ(moved, std::min(count, model.size()));
+                model.erase(model.begin(), model.begin() + moved);
+                break;
+
+            default:
+                if (random() % 16 == 0)
+                {
+                    fifo.clear();
+                    model.clear();
+                }
+                break;
+        }
+
+        CHECK_EQ(fifo.get_num_items(), model.size());
+        CHECK_EQ(fifo.is_empty(), model.empty());
+        CHECK_EQ(fifo.is_full(), model.size() == N);
+    }
+}
+
+static void test_clear_request(void)
+{
+    Fifo<Item, 8> fifo;
+    Item item;
+
+    /* Nothing requested, nothing dropped */
+    CHECK_EQ(fifo.clear_apply(), 0);
+
+    /* Only the items put before the request are dropped */
+    for (uint32_t i = 0; i < 3; i++) { item = item_make(i); fifo.put(&item); }
+    fifo.clear_request();
+    for (uint32_t i = 3; i < 5; i++) { item = item_make(i); fifo.put(&item); }
+
+    CHECK_EQ(fifo.clear_apply(), 3);
+    CHECK_EQ(fifo.get(&item), sizeof(Item));
+    CHECK(item_valid(item, 3));
+    CHECK_EQ(fifo.clear_apply(), 0);
+
+    /* The consumer has taken some of the marked items already */
+    fifo.clear();
+    for (uint32_t i = 0; i < 4; i++) { item = item_make(i); fifo.put(&item); }
+    fifo.clear_request();
+    CHECK_EQ(fifo.get(&item), sizeof(Item));
+    CHECK_EQ(fifo.clear_apply(), 3);
+    CHECK(fifo.is_empty());
+
+    /* The consumer has taken all the marked items and some put after the request */
+    for (uint32_t i = 0; i < 2; i++) { item = item_make(i); fifo.put(&item); }
+    fifo.clear_request();
+    for (uint32_t i = 2; i < 5; i++) { item = item_make(i); fifo.put(&item); }
+    Item out[3];
+    CHECK_EQ(fifo.get_n(out, 3), 3);
+    CHECK_EQ(fifo.clear_apply(), 0);
+    CHECK_EQ(fifo.get_num_items(), 2);
+
+    /* Two requests before an apply, the later one counts */
+    fifo.clear();
+    for (uint32_t i = 0; i < 2; i++) { item = item_make(i); fifo.put(&item); }
+    fifo.clear_request();
+    item = item_make(2);
+    fifo.put(&item);
+    fifo.clear_request();
+    item = item_make(3);
+    fifo.put(&item);
+    CHECK_EQ(fifo.clear_apply(), 3);
+    CHECK_EQ(fifo.get(&item), sizeof(Item));
+    CHECK(item_valid(item, 3));
+}
+
+/* The producer streams the items in random batches and requests clears now and then, the consumer applies them
+ * before every batch it takes. The items must come in order, the ones lost only to the clears, and the last one,
+ * put after the last request, must arrive */
+static void test_threads(void)
+{
+    static Fifo<Item, 16> fifo;
+    const uint32_t total = 100000;
+    std::atomic<uint32_t> clears(0);
+    std::atomic<bool> consumer_ok(true);
+    uint32_t received = 0;
+    uint32_t last_seq = 0;
+
+    std::thread producer([&]() {
+        std::mt19937 random(7);
+        Item items[8];
+        uint32_t seq = 1;
+
+        while (seq <= total)
+        {
+            size_t count = std::min<size_t>(1 + random() % 8, total + 1 - seq);
+
+            for (size_t i = 0; i < count; i++) items[i] = item_make(seq + i);
+
+            size_t moved = fifo.put_n(items, count);
+            seq += moved;
+            if (moved == 0) std::this_thread::yield();
+
+            if (seq < total - 100 && random() % 1000 == 0)
+            {
+                fifo.clear_request();
+                clears++;
+            }
+        }
+    });
+
+    std::thread consumer([&]() {
+        std::mt19937 random(11);
+        Item items[8];
+
+        while (last_seq != total)
+        {
+            fifo.clear_apply();
+
+            size_t moved = fifo.get_n(items, 1 + random() % 8);
+            if (moved == 0) std::this_thread::yield();
+
+            for (size_t i = 0; i < moved; i++)
+            {
+                if (items[i].seq <= last_seq || !item_valid(items[i], items[i].seq)) consumer_ok = false;
+                last_seq = items[i].seq;
+                received++;
+            }
+        }
+    });
+
+    producer.join();
+    consumer.join();
+
+    CHECK(consumer_ok);
+    CHECK_EQ(last_seq, total);
+    CHECK(received <= total);
+    CHECK(clears > 0 || received == total);
+    printf("threads: %u of %u items received, %u clears\n", received, total, clears.load());
+}
+
+int main(void)
+{
+    test_single();
+    test_batch();
+    test_model<1>(1);
+    test_model<2>(2);
+    test_model<7>(3);
+    test_model<16>(4);
+    test_clear_request();
+    test_threads();
+
+    return test_result();
+}
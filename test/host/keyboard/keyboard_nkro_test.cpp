@@ -0,0 +1,442 @@
+/*
+ * Host test of the NKRO keyboard report. The word-based Keyboard_ of KeyboardioHID runs side by side with the former
+ * byte-based implementation, kept here as the reference, on the same directed and random key sequences. Both must send
+ * byte-identical report sequences and answer every query the same.
+ *
+ * The benchmarks then time both on a single key changing, the full rollover toggling and the modifiers changing with
+ * the keys. The reports are only counted meanwhile, so the time is the one of the report state handling.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "hidDefy.h"
+#include "test_check.h"
+
+typedef std::vector<std::vector<uint8_t>> Report_log;
+
+static Report_log hid_reports;
+static bool hid_reports_log = true;     // Cleared by the benchmarks, which only count the reports
+static uint32_t hid_reports_count = 0;
+
+/* The report as it goes on the wire, the report ID in front of the data */
+static std::vector<uint8_t> report_bytes(uint8_t id, const void *data, size_t len)
+{
+    std::vector<uint8_t> report((const uint8_t *)data, (const uint8_t *)data + len);
+
+    report.insert(report.begin(), id);
+    return report;
+}
+
+/*************************/
+/*      HID stand-in     */
+/*************************/
+
+HID_::HID_() : setReportData{0, 0} {}
+
+HID_ &HID()
+{
+    static HID_ hid;
+    return hid;
+}
+
+void HID_::AppendDescriptor(HIDSubDescriptor *node)
+{
+    (void)node;
+}
+
+int HID_::SendReport(uint8_t id, const void *data, int len)
+{
+    hid_reports_count++;
+    if (!hid_reports_log)
+    {
+        return len;
+    }
+
+    hid_reports.push_back(report_bytes(id, data, len));
+
+    return len;
+}
+
+/*************************/
+/*       Reference       */
+/*************************/
+
+/* The byte-based implementation the word-based one replaced. Its calls are kept out of line and its reports go to the
+ * HID stand-in while benchmarking, so it pays the same call overhead as Keyboard_ from its own translation unit. */
+#define REFERENCE_CALL  __attribute__((noinline))
+
+class Reference_keyboard
+{
+    public:
+        Reference_keyboard() { memset(&report_, 0, sizeof(report_)); memset(&last_report_, 0, sizeof(last_report_)); }
+
+        Report_log reports;
+
+        void end()
+        {
+            releaseAll();
+            sendReportUnchecked();
+        }
+
+        REFERENCE_CALL int sendReport()
+        {
+            const uint8_t old_modifiers = last_report_.modifiers;
+            const uint8_t new_modifiers = report_.modifiers;
+
+            if ((old_modifiers ^ new_modifiers) != 0)
+            {
+                bool non_modifiers_toggled_off = false;
+                for (uint8_t i = 0; i < KEY_BYTES; ++i)
+                {
+                    uint8_t released_keycodes = last_report_.keys[i] & ~(report_.keys[i]);
+                    if (released_keycodes != 0)
+                    {
+                        last_report_.keys[i] &= ~released_keycodes;
+                        non_modifiers_toggled_off = true;
+                    }
+                }
+                if (non_modifiers_toggled_off)
+                {
+                    sendReportUnchecked();
+                }
+                last_report_.modifiers = new_modifiers;
+                sendReportUnchecked();
+            }
+
+            if (memcmp(last_report_.keys, report_.keys, sizeof(report_.keys)) != 0)
+            {
+                memcpy(last_report_.keys, report_.keys, sizeof(report_.keys));
+                return sendReportUnchecked();
+            }
+            return -1;
+        }
+
+        bool isModifierActive(uint8_t k)
+        {
+            return is_modifier(k) && (report_.modifiers & (1 << (k - HID_KEYBOARD_FIRST_MODIFIER)));
+        }
+
+        bool wasModifierActive(uint8_t k)
+        {
+            return is_modifier(k) && (last_report_.modifiers & (1 << (k - HID_KEYBOARD_FIRST_MODIFIER)));
+        }
+
+        bool isAnyModifierActive() { return report_.modifiers > 0; }
+        bool wasAnyModifierActive() { return last_report_.modifiers > 0; }
+
+        bool isKeyPressed(uint8_t k) { return k <= HID_LAST_KEY && (report_.keys[k / 8] & (1 << (k % 8))); }
+        bool wasKeyPressed(uint8_t k) { return k <= HID_LAST_KEY && (last_report_.keys[k / 8] & (1 << (k % 8))); }
+
+        REFERENCE_CALL size_t press(uint8_t k)
+        {
+            if (k <= HID_LAST_KEY)
+            {
+                report_.keys[k / 8] |= 1 << (k % 8);
+                return 1;
+            }
+            if (is_modifier(k))
+            {
+                report_.modifiers |= 1 << (k - HID_KEYBOARD_FIRST_MODIFIER);
+                return 1;
+            }
+            return 0;
+        }
+
+        REFERENCE_CALL size_t release(uint8_t k)
+        {
+            if (k <= HID_LAST_KEY)
+            {
+                report_.keys[k / 8] &= ~(1 << (k % 8));
+                return 1;
+            }
+            if (is_modifier(k))
+            {
+                report_.modifiers &= ~(1 << (k - HID_KEYBOARD_FIRST_MODIFIER));
+                return 1;
+            }
+            return 0;
+        }
+
+        REFERENCE_CALL void releaseAll() { memset(&report_.allkeys, 0x00, sizeof(report_.allkeys)); }
+
+    private:
+        HID_KeyboardReport_Data_t report_;
+        HID_KeyboardReport_Data_t last_report_;
+
+        static bool is_modifier(uint8_t k) { return k >= HID_KEYBOARD_FIRST_MODIFIER && k <= HID_KEYBOARD_LAST_MODIFIER; }
+
+        int sendReportUnchecked()
+        {
+            if (!hid_reports_log)
+            {
+                return HID().SendReport(HID_REPORTID_NKRO_KEYBOARD, &last_report_, sizeof(last_report_));
+            }
+
+            reports.push_back(report_bytes(HID_REPORTID_NKRO_KEYBOARD, &last_report_, sizeof(last_report_)));
+
+            return sizeof(last_report_);
+        }
+};
+
+/*************************/
+/*         Tests         */
+/*************************/
+
+/* The tests drive the global Keyboard, which starts zeroed like on the MCU. The reset sends the empty report, so both
+ * the current and the last state are clear again */
+static void keyboard_reset(void)
+{
+    Keyboard.releaseAll();
+    Keyboard.sendReport();
+    hid_reports.clear();
+}
+
+static bool queries_equal(Keyboard_ &keyboard, Reference_keyboard &reference)
+{
+    if (keyboard.isAnyModifierActive() != reference.isAnyModifierActive() ||
+        keyboard.wasAnyModifierActive() != reference.wasAnyModifierActive())
+    {
+        return false;
+    }
+
+    for (int k = 0; k <= 0xFF; k++)
+    {
+        if (keyboard.isKeyPressed(k) != reference.isKeyPressed(k) ||
+            keyboard.wasKeyPressed(k) != reference.wasKeyPressed(k) ||
+            keyboard.isModifierActive(k) != reference.isModifierActive(k) ||
+            keyboard.wasModifierActive(k) != reference.wasModifierActive(k))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* The reports of one sendReport() on a change of both the modifiers and the keys: the released keys go first, the
+ * modifiers next and the pressed keys last */
+static void test_report_order(void)
+{
+    Keyboard_ &keyboard = Keyboard;
+    const size_t report_len = 1 + 1 + KEY_BYTES;
+
+    keyboard_reset();
+
+    keyboard.press(HID_KEYBOARD_A_AND_A);
+    keyboard.press(HID_KEYBOARD_LEFT_SHIFT);
+    keyboard.sendReport();
+    CHECK_EQ(hid_reports.size(), 2);
+
+    keyboard.release(HID_KEYBOARD_A_AND_A);
+    keyboard.release(HID_KEYBOARD_LEFT_SHIFT);
+    keyboard.press(HID_KEYBOARD_B_AND_B);
+    keyboard.press(HID_KEYBOARD_LEFT_CONTROL);
+    keyboard.sendReport();
+    CHECK_EQ(hid_reports.size(), 5);
+
+    /* A released, shift still on */
+    CHECK_EQ(hid_reports[2].size(), report_len);
+    CHECK_EQ(hid_reports[2][1], 1 << (HID_KEYBOARD_LEFT_SHIFT - HID_KEYBOARD_FIRST_MODIFIER));
+    CHECK_EQ(hid_reports[2][2 + HID_KEYBOARD_A_AND_A / 8], 0);
+
+    /* Modifiers switched, B not yet on */
+    CHECK_EQ(hid_reports[3][1], 1 << (HID_KEYBOARD_LEFT_CONTROL - HID_KEYBOARD_FIRST_MODIFIER));
+    CHECK_EQ(hid_reports[3][2 + HID_KEYBOARD_B_AND_B / 8], 0);
+
+    /* B on */
+    CHECK_EQ(hid_reports[4][2 + HID_KEYBOARD_B_AND_B / 8], 1 << (HID_KEYBOARD_B_AND_B % 8));
+
+    /* Nothing changed, nothing sent */
+    CHECK_EQ(keyboard.sendReport(), -1);
+    CHECK_EQ(hid_reports.size(), 5);
+
+    /* The highest key lands in the last bits of the report */
+    keyboard.press(HID_LAST_KEY);
+    keyboard.sendReport();
+    CHECK_EQ(hid_reports.size(), 6);
+    CHECK_EQ(hid_reports[5][2 + HID_LAST_KEY / 8], 1 << (HID_LAST_KEY % 8));
+    CHECK(keyboard.wasKeyPressed(HID_LAST_KEY));
+}
+
+static void test_random(uint32_t seed, int steps)
+{
+    Keyboard_ &keyboard = Keyboard;
+    Reference_keyboard reference;
+    std::mt19937 random(seed);
+    size_t checked = 0;
+
+    /* A small pool of keys, so the presses and the releases meet */
+    const uint8_t pool[] = { HID_KEYBOARD_A_AND_A, HID_KEYBOARD_1_AND_EXCLAMATION_POINT, HID_KEYBOARD_SPACEBAR,
+                             HID_KEYBOARD_LEFT_SHIFT, HID_KEYBOARD_LEFT_CONTROL, HID_KEYBOARD_RIGHT_GUI,
+                             31, 32, 63, 64, HID_LAST_KEY, HID_LAST_KEY + 1, 0xFF };
+
+    keyboard_reset();
+
+    for (int step = 0; step < steps; step++)
+    {
+        uint8_t k = (random() % 4 == 0) ? (uint8_t)random() : pool[random() % sizeof(pool)];
+
+        switch (random() % 16)
+        {
+            case 0 ... 5:
+                CHECK_EQ(keyboard.press(k), reference.press(k));
+                break;
+
+            case 6 ... 11:
+                CHECK_EQ(keyboard.release(k), reference.release(k));
+                break;
+
+            case 12:
+                if (random() % 8 == 0)
+                {
+                    keyboard.releaseAll();
+                    reference.releaseAll();
+                }
+                else if (random() % 64 == 0)
+                {
+                    keyboard.end();
+                    reference.end();
+                }
+                break;
+
+            default:
+                CHECK_EQ(keyboard.sendReport(), reference.sendReport());
+                break;
+        }
+
+        if (hid_reports.size() != reference.reports.size() ||
+            !std::equal(hid_reports.begin() + checked, hid_reports.end(), reference.reports.begin() + checked))
+        {
+            CHECK(hid_reports == reference.reports);
+            printf("random seed %u: the reports differ at the step %d\n", seed, step);
+            return;
+        }
+        checked = hid_reports.size();
+
+        if (step % 16 == 0 && !queries_equal(keyboard, reference))
+        {
+            CHECK(queries_equal(keyboard, reference));
+            printf("random seed %u: the queries differ at the step %d\n", seed, step);
+            return;
+        }
+    }
+
+    CHECK(queries_equal(keyboard, reference));
+    printf("random seed %u: %zu reports equal\n", seed, hid_reports.size());
+}
+
+/*************************/
+/*       Benchmarks      */
+/*************************/
+
+/* Nanoseconds per cycle of the pattern, the best of a few runs. Both implementations must send the same reports. */
+template <typename K, typename P>
+static double bench_ns(K &keyboard, P pattern, int cycles, uint32_t &reports)
+{
+    double best = 1e30;
+
+    hid_reports_log = false;
+    for (int run = 0; run < 5; run++)
+    {
+        hid_reports_count = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < cycles; i++)
+        {
+            pattern(keyboard, i);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / cycles);
+    }
+    hid_reports_log = true;
+    reports = hid_reports_count;
+
+    return best;
+}
+
+template <typename P>
+static void bench(const char *name, P pattern, int cycles)
+{
+    Reference_keyboard reference;
+    uint32_t keyboard_reports;
+    uint32_t reference_reports;
+
+    keyboard_reset();
+    double const keyboard_ns = bench_ns(Keyboard, pattern, cycles, keyboard_reports);
+    double const reference_ns = bench_ns(reference, pattern, cycles, reference_reports);
+    keyboard_reset();
+
+    CHECK_EQ(keyboard_reports, reference_reports);
+    /* The same order as the byte-wise reference, with room for the timing noise of the machine. The timings of the
+     * development machine do not carry over to the M0+, so they are printed and not compared any closer. */
+    CHECK(keyboard_ns < 3 * reference_ns);
+
+    printf("bench %-28s %8.1f ns word-based, %8.1f ns byte-wise per cycle, %.2f reports\n", name, keyboard_ns,
+           reference_ns, (double)keyboard_reports / cycles);
+}
+
+/* Typing with a few keys held: one key goes down and up again */
+template <typename K>
+static void pattern_single_key(K &keyboard, int i)
+{
+    if (i == 0)
+    {
+        keyboard.press(HID_KEYBOARD_W_AND_W);
+        keyboard.press(HID_KEYBOARD_LEFT_SHIFT);
+        keyboard.sendReport();
+    }
+    keyboard.press(HID_KEYBOARD_SPACEBAR);
+    keyboard.sendReport();
+    keyboard.release(HID_KEYBOARD_SPACEBAR);
+    keyboard.sendReport();
+}
+
+/* The worst case of the rollover: every key goes down at once, then up again */
+template <typename K>
+static void pattern_full_rollover(K &keyboard, int i)
+{
+    (void)i;
+    for (int k = HID_KEYBOARD_A_AND_A; k <= HID_LAST_KEY; k++)
+    {
+        keyboard.press(k);
+    }
+    keyboard.sendReport();
+    keyboard.releaseAll();
+    keyboard.sendReport();
+}
+
+/* Shortcuts: the modifiers and the keys change within one report, so the ordered reports are needed */
+template <typename K>
+static void pattern_modifiers(K &keyboard, int i)
+{
+    (void)i;
+    keyboard.press(HID_KEYBOARD_LEFT_CONTROL);
+    keyboard.press(HID_KEYBOARD_C_AND_C);
+    keyboard.sendReport();
+    keyboard.release(HID_KEYBOARD_LEFT_CONTROL);
+    keyboard.release(HID_KEYBOARD_C_AND_C);
+    keyboard.press(HID_KEYBOARD_LEFT_SHIFT);
+    keyboard.press(HID_KEYBOARD_V_AND_V);
+    keyboard.sendReport();
+    keyboard.release(HID_KEYBOARD_LEFT_SHIFT);
+    keyboard.release(HID_KEYBOARD_V_AND_V);
+    keyboard.sendReport();
+}
+
+int main(void)
+{
+    test_report_order();
+
+    for (uint32_t seed = 1; seed <= 8; seed++)
+    {
+        test_random(seed, 25000);
+    }
+
+    bench("single key", [](auto &keyboard, int i) { pattern_single_key(keyboard, i); }, 200000);
+    bench("full rollover", [](auto &keyboard, int i) { pattern_full_rollover(keyboard, i); }, 20000);
+    bench("modifiers with keys", [](auto &keyboard, int i) { pattern_modifiers(keyboard, i); }, 200000);
+
+    return test_result();
+}
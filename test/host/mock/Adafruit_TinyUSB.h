@@ -0,0 +1,14 @@
+/*
+ * Host stand-in for the Adafruit TinyUSB library. It only has the types the KeyboardioHID headers need to compile.
+ */
+
+#ifndef __HOST_ADAFRUIT_TINYUSB_H__
+#define __HOST_ADAFRUIT_TINYUSB_H__
+
+class Adafruit_USBD_HID
+{
+};
+
+typedef struct tu_fifo_t tu_fifo_t;
+
+#endif  // __HOST_ADAFRUIT_TINYUSB_H__
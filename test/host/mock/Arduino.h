@@ -0,0 +1,42 @@
+/*
+ * Host stand-in for the parts of the Arduino core used by the sources built in test/host. The time is simulated, see
+ * host_time.h.
+ */
+
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "host_time.h"
+
+#define XIP_BASE    0x10000000
+#define PROGMEM
+
+static inline void noInterrupts( void ) {}
+static inline void interrupts( void ) {}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern unsigned long millis( void );
+extern unsigned long micros( void );
+
+#ifdef __cplusplus
+}
+
+class RP2040
+{
+    public:
+        void idleOtherCore( void ) {}
+        void resumeOtherCore( void ) {}
+};
+
+inline RP2040 rp2040;
+#endif
+
+#endif  // __HOST_ARDUINO_H__
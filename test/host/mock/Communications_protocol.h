@@ -0,0 +1,53 @@
+/*
+ * Host stand-in for the Communications library, which is not part of this tree. It only has the packet layout and the
+ * commands used by the SPI slave and the host simulators.
+ */
+
+#ifndef __HOST_COMMUNICATIONS_PROTOCOL_H__
+#define __HOST_COMMUNICATIONS_PROTOCOL_H__
+
+#include <stdint.h>
+
+#define MAX_TRANSFER_SIZE 32
+
+namespace Communications_protocol {
+
+enum Commands : uint8_t {
+    IS_DEAD = 1,
+    IS_ALIVE,
+    SLEEP,
+    WAKE_UP,
+    HAS_KEYS,
+    BATTERY_LEVEL,
+    MODE_LED,
+};
+
+enum Devices : uint8_t {
+    UNKNOWN = 0,
+    KEYSCANNER_DEFY_LEFT,
+    KEYSCANNER_DEFY_RIGHT,
+    NEURON_DEFY_WIRED = 5,
+};
+
+union Header {
+    struct {
+        Commands command;
+        Devices device : 7;
+        bool has_more_packets : 1;
+        uint8_t size;
+        uint8_t crc;
+    };
+    uint8_t buf[4];
+};
+
+union Packet {
+    struct {
+        Header header;
+        uint8_t data[MAX_TRANSFER_SIZE - sizeof(Header)];
+    };
+    uint8_t buf[MAX_TRANSFER_SIZE];
+};
+
+}  // namespace Communications_protocol
+
+#endif  // __HOST_COMMUNICATIONS_PROTOCOL_H__
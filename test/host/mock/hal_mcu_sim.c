@@ -0,0 +1,260 @@
+/*
+ * Host mock of the HAL used by the SPI slave, see hal_mcu_sim.h.
+ */
+
+#include <string.h>
+
+#include "hal_mcu_sim.h"
+#include "hal_mcu_mutex.h"
+
+#define SIM_SPI_COUNT       2
+#define SIM_GPIO_COUNT      32
+
+struct hal_mcu_spi
+{
+    hal_mcu_spi_periph_def_t def;
+    bool_t initialized;
+
+    bool_t armed;
+    hal_mcu_spi_transfer_conf_t transfer_conf;
+
+    hal_mcu_spi_slave_stats_t stats;
+};
+
+struct hal_mcu_gpio
+{
+    hal_mcu_gpio_pin_t pin;
+    bool_t level;
+};
+
+struct hal_mcu_mutex
+{
+    bool_t locked;
+};
+
+static struct hal_mcu_spi _spi[ SIM_SPI_COUNT ];
+static struct hal_mcu_gpio _gpio[ SIM_GPIO_COUNT ];
+
+/*************************/
+/*          SPI          */
+/*************************/
+
+result_t hal_mcu_spi_init( hal_mcu_spi_t ** pp_spi, const hal_mcu_spi_conf_t * p_conf )
+{
+    hal_mcu_spi_t * p_spi;
+
+    if( p_conf->def < HAL_MCU_SPI_PERIPH_DEF_SPI0 || p_conf->def > HAL_MCU_SPI_PERIPH_DEF_SPI1 || p_conf->role != HAL_MCU_SPI_ROLE_SLAVE )
+    {
+        return RESULT_ERR;
+    }
+
+    p_spi = &_spi[ p_conf->def - HAL_MCU_SPI_PERIPH_DEF_SPI0 ];
+    memset( p_spi, 0x00, sizeof( *p_spi ) );
+    p_spi->def = p_conf->def;
+    p_spi->initialized = true;
+
+    *pp_spi = p_spi;
+
+    return RESULT_OK;
+}
+
+result_t hal_mcu_spi_reserve( hal_mcu_spi_t * p_spi, const hal_mcu_spi_line_conf_t * p_line_conf, hal_mcu_spi_lock_t * p_lock )
+{
+    UNUSED( p_spi );
+    UNUSED( p_line_conf );
+
+    *p_lock = 0;
+
+    return RESULT_OK;
+}
+
+void hal_mcu_spi_release( hal_mcu_spi_t * p_spi, hal_mcu_spi_lock_t lock )
+{
+    UNUSED( p_spi );
+    UNUSED( lock );
+}
+
+result_t hal_mcu_spi_data_transfer( hal_mcu_spi_t * p_spi, const hal_mcu_spi_transfer_conf_t * p_transfer_conf )
+{
+    if( p_spi->armed == true )
+    {
+        /* The link arms the slave again only after the previous transfer is done */
+        return RESULT_ERR;
+    }
+
+    p_spi->transfer_conf = *p_transfer_conf;
+    p_spi->armed = true;
+
+    if( p_transfer_conf->slave_handlers.buffers_set_done_handler != NULL )
+    {
+        p_transfer_conf->slave_handlers.buffers_set_done_handler( p_transfer_conf->slave_handlers.p_instance );
+    }
+
+    return RESULT_OK;
+}
+
+bool_t hal_mcu_spi_is_slave( hal_mcu_spi_t * p_spi )
+{
+    UNUSED( p_spi );
+
+    return true;
+}
+
+void hal_mcu_spi_slave_stats_get( hal_mcu_spi_t * p_spi, hal_mcu_spi_slave_stats_t * p_stats )
+{
+    *p_stats = p_spi->stats;
+}
+
+void hal_mcu_spi_slave_stats_reset( hal_mcu_spi_t * p_spi )
+{
+    memset( &p_spi->stats, 0x00, sizeof( p_spi->stats ) );
+}
+
+hal_mcu_spi_t * hal_mcu_spi_sim_get( hal_mcu_spi_periph_def_t def )
+{
+    hal_mcu_spi_t * p_spi;
+
+    if( def < HAL_MCU_SPI_PERIPH_DEF_SPI0 || def > HAL_MCU_SPI_PERIPH_DEF_SPI1 )
+    {
+        return NULL;
+    }
+
+    p_spi = &_spi[ def - HAL_MCU_SPI_PERIPH_DEF_SPI0 ];
+
+    return ( p_spi->initialized == true ) ? p_spi : NULL;
+}
+
+bool_t hal_mcu_spi_sim_frame( hal_mcu_spi_t * p_spi, const uint8_t * p_mosi, uint8_t * p_miso, size_t len )
+{
+    hal_mcu_spi_transfer_conf_t transfer_conf;
+    hal_mcu_spi_transfer_result_t transfer_result;
+
+    memset( p_miso, 0xFF, len );
+
+    if( p_spi->armed == false )
+    {
+        return false;
+    }
+
+    /* The chip-select release ends the transfer. The slave must be armed again from the handler */
+    transfer_conf = p_spi->transfer_conf;
+    p_spi->armed = false;
+
+    transfer_result.data_out_len = ( len < transfer_conf.data_out_len ) ? len : transfer_conf.data_out_len;
+    transfer_result.data_in_len = ( len < transfer_conf.data_in_len ) ? len : transfer_conf.data_in_len;
+
+    if( transfer_conf.p_data_out != NULL )
+    {
+        memcpy( p_miso, transfer_conf.p_data_out, transfer_result.data_out_len );
+    }
+    else
+    {
+        transfer_result.data_out_len = 0;
+    }
+
+    if( transfer_conf.p_data_in != NULL )
+    {
+        memcpy( transfer_conf.p_data_in, p_mosi, transfer_result.data_in_len );
+    }
+    else
+    {
+        transfer_result.data_in_len = 0;
+    }
+
+    p_spi->stats.rearm_fast_count++;
+
+    transfer_conf.slave_handlers.transfer_done_handler( transfer_conf.slave_handlers.p_instance, &transfer_result );
+
+    return true;
+}
+
+/*************************/
+/*         GPIO          */
+/*************************/
+
+result_t hal_mcu_gpio_init( hal_mcu_gpio_t ** pp_gpio, const hal_mcu_gpio_conf_t * p_conf )
+{
+    hal_mcu_gpio_t * p_gpio;
+
+    if( ( uint32_t )p_conf->pin >= SIM_GPIO_COUNT )
+    {
+        return RESULT_ERR;
+    }
+
+    p_gpio = &_gpio[ p_conf->pin ];
+    p_gpio->pin = p_conf->pin;
+    p_gpio->level = ( p_conf->direction == HAL_MCU_GPIO_DIR_OUTPUT ) ? p_conf->dir_conf.output.init_val : false;
+
+    *pp_gpio = p_gpio;
+
+    return RESULT_OK;
+}
+
+result_t hal_mcu_gpio_config( hal_mcu_gpio_t * p_gpio, const hal_mcu_gpio_conf_t * p_conf )
+{
+    if( p_conf->direction == HAL_MCU_GPIO_DIR_OUTPUT )
+    {
+        p_gpio->level = p_conf->dir_conf.output.init_val;
+    }
+
+    return RESULT_OK;
+}
+
+result_t hal_mcu_gpio_out( hal_mcu_gpio_t * p_gpio, bool_t state )
+{
+    p_gpio->level = state;
+
+    return RESULT_OK;
+}
+
+result_t hal_mcu_gpio_in( hal_mcu_gpio_t * p_gpio, bool_t * p_state )
+{
+    *p_state = p_gpio->level;
+
+    return RESULT_OK;
+}
+
+bool_t hal_mcu_gpio_sim_get( hal_mcu_gpio_pin_t pin )
+{
+    if( ( uint32_t )pin >= SIM_GPIO_COUNT )
+    {
+        return false;
+    }
+
+    return _gpio[ pin ].level;
+}
+
+/*************************/
+/*         Mutex         */
+/*************************/
+
+void hal_mcu_mutex_init( hal_mcu_mutex_t ** __mutex )
+{
+    hal_mcu_mutex_t * p_mutex = heap_alloc( sizeof( hal_mcu_mutex_t ) );
+
+    p_mutex->locked = false;
+
+    *__mutex = p_mutex;
+}
+
+void hal_mcu_mutex_destroy( hal_mcu_mutex_t * _mutex )
+{
+    UNUSED( _mutex );
+}
+
+bool_t hal_mcu_mutex_trylock( hal_mcu_mutex_t * _mutex )
+{
+    if( _mutex->locked == true )
+    {
+        return false;
+    }
+
+    _mutex->locked = true;
+
+    return true;
+}
+
+void hal_mcu_mutex_unlock( hal_mcu_mutex_t * _mutex )
+{
+    _mutex->locked = false;
+}
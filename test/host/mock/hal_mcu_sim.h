@@ -0,0 +1,36 @@
+/*
+ * Host mock of the hal_mcu_spi, hal_mcu_gpio and hal_mcu_mutex APIs. The SPI is the slave peripheral the SPI link layer
+ * arms for every transfer. The master side below clocks one chip-select frame against it, the way the DMA of the RP2040
+ * HAL does:
+ *  - The bytes of the armed slave output go to the master, the rest of the frame reads as 0xFF.
+ *  - The master bytes go to the armed slave input, up to its length.
+ *  - The transfer done handler gets both counts on the chip-select release, in place of the interrupt.
+ *
+ * A frame clocked while the slave is not armed is lost: the slave sees nothing and the master reads 0xFF only.
+ */
+
+#ifndef __HAL_MCU_SIM_H_
+#define __HAL_MCU_SIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dl_middleware.h"
+#include "hal_mcu_gpio.h"
+#include "hal_mcu_spi.h"
+
+/* Returns the SPI instance of the peripheral, NULL until the slave has initialized it */
+extern hal_mcu_spi_t * hal_mcu_spi_sim_get( hal_mcu_spi_periph_def_t def );
+
+/* Clocks one chip-select frame of len bytes. Returns false if the slave was not armed and the frame got lost */
+extern bool_t hal_mcu_spi_sim_frame( hal_mcu_spi_t * p_spi, const uint8_t * p_mosi, uint8_t * p_miso, size_t len );
+
+/* The level of an output pin */
+extern bool_t hal_mcu_gpio_sim_get( hal_mcu_gpio_pin_t pin );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HAL_MCU_SIM_H_ */
@@ -0,0 +1,15 @@
+/*
+ * Host stand-in for the Pico SDK hardware/flash.h, the flash is simulated by test/host/eeprom/flash_sim.cpp. The offsets
+ * are from XIP_BASE like on the MCU, but pointer sized, as the simulated flash lies anywhere in the host memory.
+ */
+
+#ifndef __HOST_HARDWARE_FLASH_H__
+#define __HOST_HARDWARE_FLASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+void flash_range_erase(intptr_t flash_offs, size_t count);
+void flash_range_program(intptr_t flash_offs, const uint8_t *data, size_t count);
+
+#endif  // __HOST_HARDWARE_FLASH_H__
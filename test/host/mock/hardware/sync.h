@@ -0,0 +1,14 @@
+/*
+ * Host stand-in for the Pico SDK hardware/sync.h. The barrier orders the accesses of the host threads the same way the
+ * DMB does on the RP2040.
+ */
+
+#ifndef __HOST_HARDWARE_SYNC_H__
+#define __HOST_HARDWARE_SYNC_H__
+
+static inline void __dmb( void )
+{
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+}
+
+#endif  // __HOST_HARDWARE_SYNC_H__
@@ -0,0 +1,28 @@
+/*
+ * Simulated time, see host_time.h.
+ */
+
+#include "Arduino.h"
+#include "host_time.h"
+
+static uint64_t _time_us = 0;
+
+uint64_t host_time_us_get( void )
+{
+    return _time_us;
+}
+
+void host_time_us_set( uint64_t time_us )
+{
+    _time_us = time_us;
+}
+
+unsigned long millis( void )
+{
+    return ( unsigned long )( _time_us / 1000 );
+}
+
+unsigned long micros( void )
+{
+    return ( unsigned long )_time_us;
+}
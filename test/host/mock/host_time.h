@@ -0,0 +1,22 @@
+/*
+ * Simulated time of the host builds. millis() and micros() of the Arduino.h stand-in read it, and the simulators move it
+ * forward as their events happen.
+ */
+
+#ifndef __HOST_TIME_H__
+#define __HOST_TIME_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint64_t host_time_us_get( void );
+extern void host_time_us_set( uint64_t time_us );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HOST_TIME_H__
@@ -0,0 +1,903 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2024  Dygma Lab S.L.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Host simulator of the SPI link between a keyscanner, the SPI master, and the Neuron. The Neuron side is the real
+ * Spi_slave with the SPI link layer, the packet FIFOs and the CRC, running on the mocked HAL of test/host/mock. The
+ * virtual master speaks the link protocol in simulated time:
+ *
+ *  - Every frame is full duplex. The slave answers the previous frame with the result message it has armed, so the
+ *    master learns the outcome of a frame from the next one.
+ *  - The key packets go out as MASTER_DATA_SEND_START followed by DATA. The DATA is sent right after the START, and it
+ *    is sent again with a new START when its outcome is not OK or OK_BUSY.
+ *  - The packets of the Neuron are fetched with MASTER_DATA_RECV_START, once a DATA_READY result, the INT signal or the
+ *    data piggybacked on a result message shows them.
+ *  - A frame clocked while the slave is not armed reads 0xFF and is lost, the master repeats its step.
+ *
+ * The Neuron main loop runs Spi_slave::run() every loop period, reads the key packets from the rx_fifo and queues its
+ * own packets into the tx_fifo. Every packet carries a sequence number, so the simulator checks that all of them
+ * arrive once and in order and reports their latency from the generation to the delivery.
+ *
+ * An EEPROM update may run in the middle of the traffic. Each of its flash operations freezes the Neuron with the
+ * interrupts off, the frames ending meanwhile are lost. The stepped update does one operation per loop, so the link
+ * runs between them; the blocking one does them all in a single loop.
+ *
+ * The link variants are chosen at build time, see test/host/CMakeLists.txt. The traffic and the timing are options:
+ *
+ *     spi_link_sim --mix=gaming --duration-ms=5000 --loop-us=500 --int
+ *     spi_link_sim --mix=gaming --duration-ms=500 --eeprom-at-ms=100 [--eeprom-blocking]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "CRC_wrapper.h"
+#include "Spi_slave.h"
+#include "hal_mcu_sim.h"
+#include "host_time.h"
+#include "link/spi_link_def.h"
+
+#ifndef SPILS_TRANSFER_DONE_DEFERRED
+#define SPILS_TRANSFER_DONE_DEFERRED    false
+#endif
+#ifndef SPILS_DATA_PIGGYBACK_ENABLE
+#define SPILS_DATA_PIGGYBACK_ENABLE     false
+#endif
+
+using Communications_protocol::Packet;
+
+#define SIM_PIN_INT                 24
+#define SIM_PACKETS_PER_MESSAGE     4       /* The SPILS_MESSAGE_SIZE_MAX of Spi_slave.cpp */
+#define SIM_MESSAGE_LEN_MAX         ( sizeof( spil_mess_header_t ) + SIM_PACKETS_PER_MESSAGE * sizeof( Packet ) )
+#define SIM_FRAME_LEN_MAX           ( 2 * SIM_MESSAGE_LEN_MAX )
+
+/* An update of the whole 8 KB EEPROM image into the sector slots: per sector one erase and 16 page programs, then the
+ * record of the new slots. The timings are the ones of the flash simulator of test/host/eeprom. */
+#define SIM_EEPROM_SECTORS          2
+#define SIM_EEPROM_SECTOR_PAGES     16
+#define SIM_FLASH_ERASE_US          45000
+#define SIM_FLASH_PROGRAM_US        400
+
+/*************************/
+/*     Configuration     */
+/*************************/
+
+struct Sim_mix
+{
+    const char *name;
+    uint32_t keys_per_s;    /* Key packets from the master */
+    uint32_t leds_per_s;    /* Packets from the Neuron */
+    uint32_t burst;         /* Packets generated at once */
+};
+
+static const Sim_mix sim_mixes[] =
+{
+    { "idle",   0,     0,     1 },
+    { "typing", 125,   0,     1 },
+    { "gaming", 1000,  0,     1 },
+    { "leds",   0,     2000,  4 },
+    { "mixed",  1000,  2000,  4 },
+    { "flood",  50000, 50000, 4 },
+};
+
+struct Sim_conf
+{
+    const char *mix = "typing";
+    uint32_t keys_per_s = 125;
+    uint32_t leds_per_s = 0;
+    uint32_t burst = 1;
+
+    uint32_t duration_ms = 2000;
+    uint32_t drain_ms = 2000;           /* Time left to deliver the queued packets once the traffic stops */
+    uint32_t spi_hz = 4000000;
+    uint32_t frame_overhead_us = 4;     /* Chip-select setup and release around every frame */
+    uint32_t frame_gap_us = 20;         /* Pause of the master after every frame */
+    uint32_t poll_us = 1000;            /* Keep-alive and data ready poll period of the master */
+    uint32_t loop_us = 200;             /* Neuron main loop period */
+    bool int_enable = false;
+    uint32_t seed = 1;                  /* Of the jitter of the packet generation */
+
+    uint32_t eeprom_at_ms = 0;          /* Start of an EEPROM update, 0 for none */
+    bool eeprom_blocking = false;       /* All its flash operations in one loop instead of one per loop */
+};
+
+/*************************/
+/*       Statistics      */
+/*************************/
+
+class Latency
+{
+    public:
+        void add(uint64_t latency_us) { samples.push_back(latency_us); }
+
+        void print(const char *name)
+        {
+            uint64_t sum = 0;
+
+            if (samples.empty())
+            {
+                printf("  %-26s -\n", name);
+                return;
+            }
+
+            std::sort(samples.begin(), samples.end());
+            for (uint64_t sample : samples) sum += sample;
+
+            printf("  %-26s min %llu  avg %llu  p99 %llu  max %llu us\n", name,
+                   (unsigned long long)samples.front(),
+                   (unsigned long long)(sum / samples.size()),
+                   (unsigned long long)samples[(samples.size() * 99) / 100],
+                   (unsigned long long)samples.back());
+        }
+
+    private:
+        std::vector<uint64_t> samples;
+};
+
+struct Stream
+{
+    std::vector<uint64_t> generated_us;     /* Generation time by the sequence number */
+    uint32_t delivered = 0;                 /* The next sequence number expected at the receiver */
+    uint32_t errors = 0;                    /* Packets lost, repeated, reordered or damaged */
+    uint64_t payload_bytes = 0;
+    Latency latency;
+
+    uint32_t generate(void)
+    {
+        generated_us.push_back(host_time_us_get());
+        return (uint32_t)(generated_us.size() - 1);
+    }
+
+    void deliver(const Packet &packet)
+    {
+        uint32_t seq;
+
+        memcpy(&seq, packet.data, sizeof(seq));
+        if (seq != delivered || seq >= generated_us.size())
+        {
+            errors++;
+            return;
+        }
+
+        delivered++;
+        payload_bytes += packet.header.size;
+        latency.add(host_time_us_get() - generated_us[seq]);
+    }
+
+    bool done(void) { return delivered == generated_us.size(); }
+};
+
+struct Master_stats
+{
+    uint64_t frames = 0;
+    uint64_t frames_lost = 0;           /* Clocked while the slave was not armed or the Neuron was frozen */
+    uint64_t bytes_clocked = 0;
+
+    uint64_t data_sent = 0;             /* DATA messages confirmed by the slave */
+    uint64_t data_received = 0;
+    uint64_t data_piggybacked = 0;
+
+    uint64_t result_busy = 0;           /* Outcome of a DATA or RECV_START step */
+    uint64_t result_ok_busy = 0;
+    uint64_t result_err = 0;
+    uint64_t resent = 0;                /* DATA messages sent again */
+    uint64_t recv_retried = 0;          /* RECV_START refused */
+    uint64_t packets_crc_err = 0;
+};
+
+/*************************/
+/*     Virtual master    */
+/*************************/
+
+typedef enum
+{
+    STEP_NONE = 0,
+    STEP_POLL,
+    STEP_SEND_START,
+    STEP_SEND_DATA,
+    STEP_RECV_START,
+} master_step_t;
+
+class Spi_master_sim
+{
+    public:
+        Spi_master_sim(const Sim_conf &_conf, Stream &_keys, Stream &_leds) : conf(_conf), keys(_keys), leds(_leds) {}
+
+        std::deque<Packet> tx_queue;
+        Master_stats stats;
+
+        /* Starts the next frame if there is something to do, returns its duration or 0 */
+        uint32_t frame_start(hal_mcu_spi_t *p_spi);
+        bool frame_end(bool frozen);
+
+        bool idle(void) { return tx_queue.empty() && awaiting != STEP_SEND_START && data_packets == 0; }
+
+    private:
+        const Sim_conf &conf;
+        Stream &keys;
+        Stream &leds;
+
+        hal_mcu_spi_t *p_spi = nullptr;
+
+        master_step_t awaiting = STEP_NONE;     /* The last step the slave has received, the next frame reads its outcome */
+        master_step_t step = STEP_NONE;         /* The step of the frame in progress */
+        size_t data_packets = 0;                /* The packets of the awaited DATA message, still at the tx_queue front */
+        size_t step_packets = 0;
+
+        bool slave_data_ready = false;
+        bool recv_turn = false;
+        uint64_t poll_next_us = 0;
+
+        uint8_t mosi[SIM_FRAME_LEN_MAX];
+        uint8_t miso[SIM_FRAME_LEN_MAX];
+        size_t frame_len = 0;
+
+        size_t message_compose(master_step_t _step);
+        void data_parse(const uint8_t *p_message, size_t len);
+        void outcome_process(void);
+};
+
+uint32_t Spi_master_sim::frame_start(hal_mcu_spi_t *_p_spi)
+{
+    size_t out_len;
+    size_t in_len;
+    bool int_signal = conf.int_enable && hal_mcu_gpio_sim_get((hal_mcu_gpio_pin_t)SIM_PIN_INT);
+
+    p_spi = _p_spi;
+
+    bool send_due = tx_queue.size() > data_packets;
+    bool recv_due = awaiting != STEP_RECV_START && (slave_data_ready || int_signal);
+
+    /* The DATA follows its START right away. Only one DATA message is in flight, its outcome comes with the next frame.
+     * The directions take turns when both have data, so neither starves the other */
+    if (awaiting == STEP_SEND_START)
+    {
+        step = STEP_SEND_DATA;
+    }
+    else if (recv_due && (recv_turn || !send_due))
+    {
+        step = STEP_RECV_START;
+    }
+    else if (send_due)
+    {
+        step = STEP_SEND_START;
+    }
+    else if (host_time_us_get() >= poll_next_us || awaiting == STEP_SEND_DATA || awaiting == STEP_RECV_START)
+    {
+        step = STEP_POLL;
+    }
+    else
+    {
+        return 0;
+    }
+
+    out_len = message_compose(step);
+
+    /* The master clocks as many bytes as the slave might answer with */
+    in_len = sizeof(spil_mess_result_t);
+    if (awaiting == STEP_RECV_START)
+    {
+        in_len = SIM_MESSAGE_LEN_MAX;
+    }
+    else if (SPILS_DATA_PIGGYBACK_ENABLE)
+    {
+        in_len = sizeof(spil_mess_result_t) + SIM_MESSAGE_LEN_MAX;
+    }
+
+    frame_len = std::max(out_len, in_len);
+    memset(mosi + out_len, 0x00, frame_len - out_len);
+
+    return conf.frame_overhead_us + (uint32_t)(((uint64_t)frame_len * 8 * 1000000 + conf.spi_hz - 1) / conf.spi_hz);
+}
+
+size_t Spi_master_sim::message_compose(master_step_t _step)
+{
+    spil_mess_header_t *p_header = (spil_mess_header_t *)mosi;
+
+    step_packets = 0;
+    p_header->len = sizeof(spil_mess_header_t);
+
+    switch (_step)
+    {
+        case STEP_SEND_START:
+            p_header->type = SPIL_MESS_TYPE_MASTER_DATA_SEND_START;
+            break;
+
+        case STEP_RECV_START:
+            p_header->type = SPIL_MESS_TYPE_MASTER_DATA_RECV_START;
+            break;
+
+        case STEP_SEND_DATA:
+            p_header->type = SPIL_MESS_TYPE_DATA;
+
+            step_packets = std::min(tx_queue.size(), (size_t)SIM_PACKETS_PER_MESSAGE);
+            for (size_t i = 0; i < step_packets; i++)
+            {
+                Packet packet = tx_queue[i];
+
+                packet.header.has_more_packets = (i + 1 < tx_queue.size());
+                packet.header.crc = 0;
+                packet.header.crc = crc8(packet.buf, sizeof(packet.header) + packet.header.size);
+                memcpy(mosi + p_header->len, &packet, sizeof(packet));
+                p_header->len += sizeof(packet);
+            }
+            break;
+
+        default:
+            p_header->type = 0x00;    /* Any other type only polls the slave */
+            break;
+    }
+
+    return p_header->len;
+}
+
+/* Ends the frame in progress, returns false if it got lost. A frozen Neuron hears nothing, as if not armed */
+bool Spi_master_sim::frame_end(bool frozen)
+{
+    stats.frames++;
+    stats.bytes_clocked += frame_len;
+    poll_next_us = host_time_us_get() + conf.poll_us;
+
+    if (frozen || hal_mcu_spi_sim_frame(p_spi, mosi, miso, frame_len) == false)
+    {
+        /* Nobody has heard the step. The outcome of the awaited one is still to come */
+        memset(miso, 0xFF, frame_len);
+        stats.frames_lost++;
+        return false;
+    }
+
+    outcome_process();
+
+    awaiting = step;
+    if (step == STEP_SEND_DATA)
+    {
+        data_packets = step_packets;
+        recv_turn = true;
+    }
+    else if (step == STEP_RECV_START)
+    {
+        recv_turn = false;
+    }
+
+    return true;
+}
+
+void Spi_master_sim::outcome_process(void)
+{
+    const spil_mess_header_t *p_header = (const spil_mess_header_t *)miso;
+    bool data_ok = false;
+
+    if (awaiting == STEP_RECV_START && p_header->type == SPIL_MESS_TYPE_DATA)
+    {
+        data_parse(miso, p_header->len);
+        stats.data_received++;
+        slave_data_ready = false;
+        return;
+    }
+
+    switch (p_header->type)
+    {
+        case SPIL_MESS_TYPE_RESULT_OK:
+            data_ok = true;
+            break;
+
+        case SPIL_MESS_TYPE_RESULT_OK_BUSY:
+            data_ok = true;
+            if (awaiting == STEP_SEND_DATA) stats.result_ok_busy++;
+            break;
+
+        case SPIL_MESS_TYPE_RESULT_BUSY:
+            if (awaiting == STEP_SEND_DATA || awaiting == STEP_RECV_START) stats.result_busy++;
+            break;
+
+        case SPIL_MESS_TYPE_RESULT_ERR:
+            if (awaiting == STEP_SEND_DATA || awaiting == STEP_RECV_START) stats.result_err++;
+            break;
+
+        case SPIL_MESS_TYPE_RESULT_READY:
+            slave_data_ready = false;
+            break;
+
+        case SPIL_MESS_TYPE_RESULT_DATA_READY:
+            slave_data_ready = true;
+            break;
+
+        default:
+            break;
+    }
+
+    if (awaiting == STEP_SEND_DATA)
+    {
+        if (data_ok)
+        {
+            for (size_t i = 0; i < data_packets; i++)
+            {
+                tx_queue.pop_front();
+            }
+            stats.data_sent++;
+        }
+        else
+        {
+            stats.resent++;
+        }
+        data_packets = 0;
+    }
+    else if (awaiting == STEP_RECV_START)
+    {
+        stats.recv_retried++;
+    }
+
+    /* The piggybacked data message follows the result within the result length */
+    if (SPILS_DATA_PIGGYBACK_ENABLE && p_header->len > sizeof(spil_mess_result_t) && p_header->len <= frame_len)
+    {
+        const spil_mess_header_t *p_data_header = (const spil_mess_header_t *)(miso + sizeof(spil_mess_result_t));
+
+        if (p_data_header->type == SPIL_MESS_TYPE_DATA && sizeof(spil_mess_result_t) + p_data_header->len == p_header->len)
+        {
+            data_parse((const uint8_t *)p_data_header, p_data_header->len);
+            stats.data_piggybacked++;
+        }
+    }
+}
+
+void Spi_master_sim::data_parse(const uint8_t *p_message, size_t len)
+{
+    Packet packet;
+    uint8_t crc;
+
+    for (size_t pos = sizeof(spil_mess_header_t); pos + sizeof(Packet) <= len; pos += sizeof(Packet))
+    {
+        memcpy(&packet, p_message + pos, sizeof(packet));
+
+        crc = packet.header.crc;
+        packet.header.crc = 0;
+        if (crc8(packet.buf, sizeof(packet.header) + packet.header.size) != crc)
+        {
+            stats.packets_crc_err++;
+            leds.errors++;
+            continue;
+        }
+
+        leds.deliver(packet);
+    }
+}
+
+/*************************/
+/*       Simulation      */
+/*************************/
+
+static Spi_slave spi_slave(0, 23, 20, 18, 21, SIM_PIN_INT);
+
+static Packet packet_make(Communications_protocol::Commands command, uint32_t seq, uint8_t size)
+{
+    Packet packet;
+
+    memset(&packet, 0x00, sizeof(packet));
+    packet.header.command = command;
+    packet.header.device = Communications_protocol::KEYSCANNER_DEFY_LEFT;
+    packet.header.size = size;
+
+    memcpy(packet.data, &seq, sizeof(seq));
+    for (uint8_t i = sizeof(seq); i < size; i++)
+    {
+        packet.data[i] = (uint8_t)(seq * 31 + i);
+    }
+
+    return packet;
+}
+
+static void neuron_loop(Stream &keys, Stream &leds, uint32_t &leds_pending)
+{
+    Packet packets[8];
+    size_t count;
+
+    spi_slave.run();
+
+    /* What SpiPort::readPackets() and the Communications do with the key packets */
+    while ((count = spi_slave.rx_fifo->get_n(packets, 8)) != 0)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            keys.deliver(packets[i]);
+        }
+    }
+
+    /* Queue the packets of the Neuron, those which do not fit wait for the next loop */
+    while (leds_pending != 0)
+    {
+        Packet packet = packet_make(Communications_protocol::MODE_LED, leds.generate(), 28);
+
+        if (spi_slave.tx_fifo->put(&packet) == false)
+        {
+            leds.generated_us.pop_back();
+            break;
+        }
+        leds_pending--;
+    }
+}
+
+static bool arg_get(const char *arg, const char *name, uint32_t &value)
+{
+    size_t len = strlen(name);
+
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+    {
+        return false;
+    }
+
+    value = (uint32_t)strtoul(arg + len + 1, nullptr, 0);
+    return true;
+}
+
+static bool args_parse(int argc, char **argv, Sim_conf &conf)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+
+        if (strncmp(arg, "--mix=", 6) == 0)
+        {
+            const Sim_mix *p_mix = nullptr;
+
+            for (const Sim_mix &mix : sim_mixes)
+            {
+                if (strcmp(arg + 6, mix.name) == 0) p_mix = &mix;
+            }
+            if (p_mix == nullptr) return false;
+
+            conf.mix = p_mix->name;
+            conf.keys_per_s = p_mix->keys_per_s;
+            conf.leds_per_s = p_mix->leds_per_s;
+            conf.burst = p_mix->burst;
+        }
+        else if (strcmp(arg, "--int") == 0)
+        {
+            conf.int_enable = true;
+        }
+        else if (strcmp(arg, "--eeprom-blocking") == 0)
+        {
+            conf.eeprom_blocking = true;
+        }
+        else if (!arg_get(arg, "--keys", conf.keys_per_s) &&
+                 !arg_get(arg, "--leds", conf.leds_per_s) &&
+                 !arg_get(arg, "--burst", conf.burst) &&
+                 !arg_get(arg, "--duration-ms", conf.duration_ms) &&
+                 !arg_get(arg, "--drain-ms", conf.drain_ms) &&
+                 !arg_get(arg, "--spi-hz", conf.spi_hz) &&
+                 !arg_get(arg, "--gap-us", conf.frame_gap_us) &&
+                 !arg_get(arg, "--poll-us", conf.poll_us) &&
+                 !arg_get(arg, "--loop-us", conf.loop_us) &&
+                 !arg_get(arg, "--eeprom-at-ms", conf.eeprom_at_ms) &&
+                 !arg_get(arg, "--seed", conf.seed))
+        {
+            return false;
+        }
+    }
+
+    if (conf.burst == 0) conf.burst = 1;
+    if (conf.loop_us == 0 || conf.spi_hz == 0 || conf.poll_us == 0 || conf.seed == 0) return false;
+
+    return true;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [--mix=NAME] [--keys=N] [--leds=N] [--burst=N] [--duration-ms=N] [--drain-ms=N]\n"
+           "       [--spi-hz=N] [--gap-us=N] [--poll-us=N] [--loop-us=N] [--int] [--seed=N]\n"
+           "       [--eeprom-at-ms=N] [--eeprom-blocking]\n"
+           "mixes:", name);
+    for (const Sim_mix &mix : sim_mixes)
+    {
+        printf(" %s", mix.name);
+    }
+    printf("\n");
+}
+
+/* Generates the bursts of a traffic stream. Every burst lands at a random point of the first half of its period, so the
+ * traffic does not run in step with the Neuron loop */
+class Traffic_source
+{
+    public:
+        Traffic_source(uint32_t per_s, uint32_t burst, uint32_t &_seed) : seed(_seed)
+        {
+            if (per_s != 0)
+            {
+                period_us = ((uint64_t)burst * 1000000 + per_s - 1) / per_s;
+                next_us = jitter();
+            }
+        }
+
+        uint64_t next_us = UINT64_MAX;
+
+        void advance(void)
+        {
+            slot_us += period_us;
+            next_us = slot_us + jitter();
+        }
+
+        void stop(void) { next_us = UINT64_MAX; }
+
+    private:
+        uint32_t &seed;
+        uint64_t period_us = 0;
+        uint64_t slot_us = 0;
+
+        uint64_t jitter(void)
+        {
+            /* xorshift32 */
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+
+            return seed % (period_us / 2 + 1);
+        }
+};
+
+/* The flash operations of an EEPROM update, run from the Neuron loop */
+class Eeprom_update
+{
+    public:
+        explicit Eeprom_update(const Sim_conf &conf) : blocking(conf.eeprom_blocking)
+        {
+            if (conf.eeprom_at_ms == 0)
+            {
+                return;
+            }
+
+            start_us = (uint64_t)conf.eeprom_at_ms * 1000;
+            for (uint32_t sector = 0; sector < SIM_EEPROM_SECTORS; sector++)
+            {
+                operations_us.push_back(SIM_FLASH_ERASE_US);
+                operations_us.insert(operations_us.end(), SIM_EEPROM_SECTOR_PAGES, SIM_FLASH_PROGRAM_US);
+            }
+            operations_us.push_back(SIM_FLASH_PROGRAM_US);
+        }
+
+        uint64_t frames_served = 0;         /* While the update runs */
+        uint64_t frames_lost = 0;
+        uint32_t freeze_max_us = 0;
+
+        /* Runs the next flash operation, or all of them when blocking. Returns how long the Neuron is frozen */
+        uint32_t step(uint64_t now_us)
+        {
+            uint32_t freeze_us = 0;
+
+            if (now_us < start_us || next == operations_us.size())
+            {
+                return 0;
+            }
+
+            if (next == 0)
+            {
+                started_us = now_us;
+            }
+            do
+            {
+                freeze_us += operations_us[next++];
+            } while (blocking && next < operations_us.size());
+
+            freeze_max_us = std::max(freeze_max_us, freeze_us);
+            if (next == operations_us.size())
+            {
+                end_us = now_us + freeze_us;
+            }
+
+            return freeze_us;
+        }
+
+        void frame_count(uint64_t now_us, bool served)
+        {
+            if (next == 0 || now_us >= end_us)
+            {
+                return;
+            }
+
+            (served ? frames_served : frames_lost)++;
+        }
+
+        bool enabled(void) { return !operations_us.empty(); }
+        bool done(void) { return operations_us.empty() || host_time_us_get() >= end_us; }
+        size_t operations(void) { return operations_us.size(); }
+        uint64_t duration_us(void) { return end_us - started_us; }
+
+    private:
+        bool blocking;
+        uint64_t start_us = 0;
+        uint64_t started_us = 0;
+        uint64_t end_us = UINT64_MAX;
+        std::vector<uint32_t> operations_us;
+        size_t next = 0;
+};
+
+int main(int argc, char **argv)
+{
+    Sim_conf conf;
+    Stream keys;
+    Stream leds;
+    uint32_t leds_pending = 0;
+    spi_slave_stats_t slave_stats;
+    hal_mcu_spi_t *p_spi;
+    double seconds;
+    bool ok;
+
+    if (!args_parse(argc, argv, conf))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Spi_master_sim master(conf, keys, leds);
+
+    host_time_us_set(0);
+    spi_slave.init();
+    p_spi = hal_mcu_spi_sim_get(HAL_MCU_SPI_PERIPH_DEF_SPI0);
+
+    const uint64_t end_us = (uint64_t)conf.duration_ms * 1000;
+    const uint64_t drain_end_us = end_us + (uint64_t)conf.drain_ms * 1000;
+
+    Traffic_source keys_source(conf.keys_per_s, conf.burst, conf.seed);
+    Traffic_source leds_source(conf.leds_per_s, conf.burst, conf.seed);
+    Eeprom_update eeprom(conf);
+    uint64_t frozen_until_us = 0;
+    bool cycle_frozen = false;
+    uint64_t loop_next_us = 0;
+    uint64_t master_next_us = 0;
+    uint64_t frame_end_us = UINT64_MAX;
+    uint64_t now_us = 0;
+
+    /* Run the traffic for the duration, then let the queues drain */
+    while (true)
+    {
+        bool generating = now_us < end_us;
+        bool drained = keys.done() && leds.done() && leds_pending == 0 && master.idle() && spi_slave.tx_fifo->is_empty() &&
+                       eeprom.done();
+
+        if (!generating && (drained || now_us >= drain_end_us))
+        {
+            break;
+        }
+
+        if (!generating)
+        {
+            keys_source.stop();
+            leds_source.stop();
+        }
+
+        now_us = std::min({ keys_source.next_us, leds_source.next_us, loop_next_us, frame_end_us, master_next_us });
+        host_time_us_set(now_us);
+
+        if (now_us == frame_end_us)
+        {
+            eeprom.frame_count(now_us, master.frame_end(now_us < frozen_until_us));
+            frame_end_us = UINT64_MAX;
+            master_next_us = now_us + conf.frame_gap_us;
+        }
+        else if (now_us == keys_source.next_us)
+        {
+            for (uint32_t i = 0; i < conf.burst; i++)
+            {
+                master.tx_queue.push_back(packet_make(Communications_protocol::HAS_KEYS, keys.generate(), 8));
+            }
+            keys_source.advance();
+        }
+        else if (now_us == leds_source.next_us)
+        {
+            leds_pending += conf.burst;
+            leds_source.advance();
+        }
+        else if (now_us == loop_next_us)
+        {
+            /*
+             * The cycle starts with the EEPROM update step, like EEPROMUpgrade::beforeEachCycle(). Its flash operation keeps
+             * the Neuron and the interrupts off, the rest of the cycle runs once it has finished.
+             */
+            uint32_t freeze_us = cycle_frozen ? 0 : eeprom.step(now_us);
+
+            if (freeze_us != 0)
+            {
+                frozen_until_us = now_us + freeze_us;
+                loop_next_us = frozen_until_us;
+                cycle_frozen = true;
+            }
+            else
+            {
+                neuron_loop(keys, leds, leds_pending);
+                loop_next_us = now_us + conf.loop_us;
+                cycle_frozen = false;
+            }
+        }
+        else
+        {
+            uint32_t frame_us = master.frame_start(p_spi);
+
+            if (frame_us != 0)
+            {
+                frame_end_us = now_us + frame_us;
+                master_next_us = UINT64_MAX;
+            }
+            else
+            {
+                master_next_us = now_us + conf.frame_gap_us;
+            }
+        }
+    }
+
+    seconds = (double)now_us / 1000000;
+    spi_slave.stats_get(&slave_stats);
+    ok = keys.done() && leds.done() && keys.errors == 0 && leds.errors == 0;
+    if (eeprom.enabled() && !conf.eeprom_blocking)
+    {
+        /* The link must keep running between the flash operations of the stepped update */
+        ok = ok && eeprom.done() && eeprom.frames_served != 0 && eeprom.freeze_max_us <= SIM_FLASH_ERASE_US;
+    }
+
+    printf("link: %s transfer processing, piggyback %s, INT %s\n",
+           SPILS_TRANSFER_DONE_DEFERRED ? "deferred" : "immediate",
+           SPILS_DATA_PIGGYBACK_ENABLE ? "on" : "off",
+           conf.int_enable ? "on" : "off");
+    printf("traffic: %s, %u key packets/s, %u Neuron packets/s in bursts of %u, %u ms + %.0f ms drain\n",
+           conf.mix, conf.keys_per_s, conf.leds_per_s, conf.burst, conf.duration_ms, seconds * 1000 - conf.duration_ms);
+    printf("timing: SPI %u Hz, frame gap %u us, poll %u us, Neuron loop %u us\n",
+           conf.spi_hz, conf.frame_gap_us, conf.poll_us, conf.loop_us);
+
+    printf("frames: %llu (%.0f/s), lost %llu, %.0f bytes/s clocked\n",
+           (unsigned long long)master.stats.frames, master.stats.frames / seconds,
+           (unsigned long long)master.stats.frames_lost, master.stats.bytes_clocked / seconds);
+    printf("master -> Neuron: %u packets (%.0f/s), %.0f payload bytes/s, %llu DATA messages\n",
+           keys.delivered, keys.delivered / seconds, keys.payload_bytes / seconds,
+           (unsigned long long)master.stats.data_sent);
+    printf("Neuron -> master: %u packets (%.0f/s), %.0f payload bytes/s, %llu DATA messages, %llu piggybacked\n",
+           leds.delivered, leds.delivered / seconds, leds.payload_bytes / seconds,
+           (unsigned long long)master.stats.data_received, (unsigned long long)master.stats.data_piggybacked);
+    if (eeprom.enabled())
+    {
+        printf("eeprom update: %s, %zu flash operations in %.1f ms, longest freeze %u us, frames meanwhile %llu served, "
+               "%llu lost\n", conf.eeprom_blocking ? "blocking" : "stepped", eeprom.operations(),
+               eeprom.duration_us() / 1000.0, eeprom.freeze_max_us, (unsigned long long)eeprom.frames_served,
+               (unsigned long long)eeprom.frames_lost);
+    }
+    printf("latency:\n");
+    keys.latency.print("key packet to Neuron app");
+    leds.latency.print("Neuron packet to master");
+    printf("retries: DATA resent %llu, RECV_START refused %llu, results BUSY %llu, OK_BUSY %llu, ERR %llu\n",
+           (unsigned long long)master.stats.resent, (unsigned long long)master.stats.recv_retried,
+           (unsigned long long)master.stats.result_busy, (unsigned long long)master.stats.result_ok_busy,
+           (unsigned long long)master.stats.result_err);
+    printf("slave: transfers %lu, idle %lu, line_in_busy %lu, saturated %lu, rx_fifo max %u, tx_fifo max %u\n",
+           (unsigned long)slave_stats.link.transfer_count, (unsigned long)slave_stats.link.transfer_idle_count,
+           (unsigned long)slave_stats.link.line_in_busy_count, (unsigned long)slave_stats.link.line_in_saturated_count,
+           slave_stats.rx_fifo_depth_max, slave_stats.tx_fifo_depth_max);
+    printf("packets: CRC errors %lu at the Neuron, %llu at the master, %lu dropped by the full rx_fifo\n",
+           (unsigned long)slave_stats.packets_crc_err_count, (unsigned long long)master.stats.packets_crc_err,
+           (unsigned long)slave_stats.packets_in_dropped_count);
+    printf("check: %s (key packets %u/%zu, Neuron packets %u/%zu, errors %u)\n", ok ? "OK" : "FAILED",
+           keys.delivered, keys.generated_us.size(), leds.delivered, leds.generated_us.size(), keys.errors + leds.errors);
+
+    return ok ? 0 : 1;
+}
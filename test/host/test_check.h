@@ -0,0 +1,45 @@
+/*
+ * Minimal checks of the host tests. A failed check is reported with its place and the test carries on, the test
+ * program returns test_result() from main(), so ctest sees the failures.
+ */
+
+#ifndef __TEST_CHECK_H__
+#define __TEST_CHECK_H__
+
+#include <stdio.h>
+
+static unsigned test_checks = 0;
+static unsigned test_failures = 0;
+
+#define CHECK(condition)                                                                    \
+    do                                                                                      \
+    {                                                                                       \
+        test_checks++;                                                                      \
+        if (!(condition))                                                                   \
+        {                                                                                   \
+            test_failures++;                                                                \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);            \
+        }                                                                                   \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                          \
+    do                                                                                      \
+    {                                                                                       \
+        long long _actual = (long long)(actual);                                            \
+        long long _expected = (long long)(expected);                                        \
+        test_checks++;                                                                      \
+        if (_actual != _expected)                                                           \
+        {                                                                                   \
+            test_failures++;                                                                \
+            printf("%s:%d: check failed: %s is %lld, expected %lld\n", __FILE__, __LINE__,  \
+                   #actual, _actual, _expected);                                            \
+        }                                                                                   \
+    } while (0)
+
+static inline int test_result(void)
+{
+    printf("%u checks, %u failed\n", test_checks, test_failures);
+    return (test_failures == 0) ? 0 : 1;
+}
+
+#endif  // __TEST_CHECK_H__